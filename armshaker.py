@@ -9,6 +9,7 @@ import argparse
 import fcntl
 import time
 import math
+import os
 
 WORKER_AREA_WIDTH = 45
 
@@ -34,7 +35,7 @@ def get_status(proc_num):
         status[key] = val.replace('\t', ' ').strip()
 
     # TODO: Remove nasty hardcode
-    if len(status) != 8:
+    if len(status) != 9:
         # Sometimes we read the statusfile while it's being written to.
         # Ideally we should have a lock or something, but this works for now...
         return None
@@ -42,6 +43,80 @@ def get_status(proc_num):
     return status
 
 
+def read_midr(cpu):
+    try:
+        path = '/sys/devices/system/cpu/cpu{}/regs/identification/midr_el1'.format(cpu)
+        with open(path, 'r') as f:
+            return int(f.read(), 16)
+    except (OSError, ValueError):
+        pass
+
+    # Fall back to /proc/cpuinfo, e.g. on AArch32 kernels
+    fields = {}
+    curr_cpu = None
+    with open('/proc/cpuinfo', 'r') as f:
+        for line in f:
+            try:
+                key, val = [x.strip() for x in line.split(':', maxsplit=1)]
+            except ValueError:
+                continue
+            if key == 'processor':
+                curr_cpu = int(val)
+            elif curr_cpu == cpu and key.startswith('CPU '):
+                try:
+                    fields[key] = int(val, 0)
+                except ValueError:
+                    pass
+
+    if 'CPU implementer' not in fields:
+        return 0
+    return ((fields['CPU implementer'] << 24)
+            | (fields.get('CPU variant', 0) << 20)
+            | (0xf << 16)
+            | (fields.get('CPU part', 0) << 4)
+            | fields.get('CPU revision', 0))
+
+
+def get_clusters():
+    # Group the CPUs by core type, i.e. the implementer and part number
+    clusters = {}
+    for cpu in sorted(os.sched_getaffinity(0)):
+        core_type = read_midr(cpu) & 0xff00fff0
+        clusters.setdefault(core_type, []).append(cpu)
+    return clusters
+
+
+def get_worker_groups(args):
+    """
+    Returns a list of (core type, CPUs) groups, where each group covers the
+    whole search range. There is a single group unless --per-cluster is set.
+    """
+    if args.per_cluster:
+        return sorted(get_clusters().items())
+    elif args.cpus:
+        return [(None, [int(cpu) for cpu in args.cpus[0].split(',')])]
+    return [(None, None)]
+
+
+def cross_diff_clusters(groups):
+    lines = []
+    for i in range(len(groups)):
+        for j in range(i + 1, len(groups)):
+            map_a = 'data/map_{:08x}'.format(groups[i][0])
+            map_b = 'data/map_{:08x}'.format(groups[j][0])
+            out_path = 'data/clusterdiff_{:08x}_{:08x}'.format(groups[i][0], groups[j][0])
+            with open(out_path, 'w') as out:
+                try:
+                    proc = subprocess.run(['tools/mapdiff', map_a, map_b],
+                                          stdout=out, stderr=subprocess.PIPE)
+                except FileNotFoundError:
+                    return 'tools/mapdiff was not found. Run "make tools" to ' \
+                           'compare the clusters.'
+            lines.append('{} vs {} ({}):'.format(map_a, map_b, out_path))
+            lines.append(proc.stderr.decode('utf-8').rstrip())
+    return '\n'.join(lines)
+
+
 def update_statuses(procs, statuses):
     # Read the statusfiles
     for proc_num in range(len(procs)):
@@ -100,7 +175,8 @@ def print_summary(pad, statuses, extra_data, just_height=False):
                                      + int(status['instructions_skipped'])
                                      + int(status['instructions_filtered']))
 
-    total_insns = extra_data['search_range'][1] - extra_data['search_range'][0] + 1
+    total_insns = ((extra_data['search_range'][1] - extra_data['search_range'][0] + 1)
+                   * extra_data['passes'])
     progress = (sum_status['insns_so_far'] / total_insns) * 100
     elapsed_hrs = (time.time() - extra_data['time_started']) / 60 / 60
 
@@ -169,13 +245,28 @@ def update_screen(pad, statuses, extra_data):
         print_worker(pad, proc_num, status, height+1)
 
 
-def start_procs(search_range, args):
+def start_procs(search_range, args, groups):
+    procs = []
+    for core_type, cpus in groups:
+        if (type(args.workers) == int  # Default val
+                or args.workers[0] <= 0):
+            proc_count = len(cpus) if cpus else multiprocessing.cpu_count()
+        else:
+            proc_count = args.workers[0]
+        if core_type is not None:
+            # Each worker of a cluster gets its own core
+            proc_count = min(proc_count, len(cpus))
+
+        group_procs = start_group(search_range, args, proc_count, len(procs),
+                                  core_type, cpus)
+        if group_procs == 0:
+            return 0
+        procs += group_procs
+    return procs
+
+
+def start_group(search_range, args, proc_count, first_proc, core_type, cpus):
     procs = []
-    if (type(args.workers) == int  # Default val
-            or args.workers[0] <= 0):
-        proc_count = multiprocessing.cpu_count()
-    else:
-        proc_count = args.workers[0]
     proc_search_size = int((search_range[1] - search_range[0] + 1) / proc_count)
     for i in range(proc_count):
         insn_start = search_range[0] + proc_search_size * i
@@ -183,8 +274,15 @@ def start_procs(search_range, args):
         if i == proc_count - 1:
             insn_end = search_range[1]
 
+        if core_type is not None:
+            result_map = 'data/map_{:08x}'.format(core_type)
+        elif args.result_map:
+            result_map = args.result_map[0]
+        else:
+            result_map = None
+
         cmd = ['./fuzzer',
-               '-l', str(i),
+               '-l', str(first_proc + i),
                '-s', hex(insn_start),
                '-e', hex(insn_end),
                '-d' if args.discreps else '',
@@ -196,6 +294,26 @@ def start_procs(search_range, args):
                '-g' if args.log_reg_changes else '',
                '-V' if args.vector else '',
                '-c' if args.cond else '',
+               '-o{}'.format(args.order[0]) if args.order else '',
+               '-M{}'.format(result_map) if result_map else '',
+               '-R' if args.rle_map else '',
+               '--diff-exec={}'.format(args.diff_exec[0]) if args.diff_exec else '',
+               '--repeat={}'.format(args.repeat[0]) if args.repeat else '',
+               '--rotate-cpus' if args.rotate_cpus else '',
+               '--cpu={}'.format(cpus[i % len(cpus)]) if cpus else '',
+               '--timeout={}'.format(args.timeout[0]) if args.timeout else '',
+               '--sandbox' if args.sandbox else '',
+               '--seccomp' if args.seccomp else '',
+               '--page-regs' if args.page_regs else '',
+               '--compat={}'.format(args.compat[0]) if args.compat else '',
+               '--timing={}'.format(args.timing[0]) if args.timing else '',
+               '--timing-perf' if args.timing_perf else '',
+               '--perf-stats' if args.perf_stats else '',
+               '--async-log' if args.async_log else '',
+               '--summary' if args.summary else '',
+               '--summary-only' if args.summary_only else '',
+               '--disas-cache' if args.disas_cache else '',
+               '--no-capstone' if args.no_capstone else '',
                '-q']
 
         try:
@@ -223,7 +341,8 @@ def refresh_pad(stdscr, pad):
 def main(stdscr, args):
     search_range = (args.start if type(args.start) is int else args.start[0],
                     args.end if type(args.end) is int else args.end[0])
-    procs = start_procs(search_range, args)
+    groups = get_worker_groups(args)
+    procs = start_procs(search_range, args, groups)
 
     if procs == 0:
         return 'The fuzzer binary was not found. It likely needs to be ' \
@@ -244,7 +363,8 @@ def main(stdscr, args):
 
     extra_data = {
             'search_range': search_range,
-            'time_started': time.time()
+            'time_started': time.time(),
+            'passes': len(groups)
     }
 
     quit_str = 'Done'
@@ -301,6 +421,9 @@ def main(stdscr, args):
     curses.curs_set(True)
     curses.endwin()
 
+    if quit_str == 'Done' and args.per_cluster and len(groups) > 1:
+        quit_str += '\n' + cross_diff_clusters(groups)
+
     return quit_str
 
 
@@ -336,7 +459,7 @@ if __name__ == '__main__':
                         metavar='LEVEL', default=0)
     parser.add_argument('-t', '--thumb',
                         action='store_true',
-                        help='Use the thumb instruction set (only on AArch32).')
+                        help='Use the thumb instruction set (on AArch32, or with --compat).')
     parser.add_argument('-z', '--random',
                         action='store_true',
                         help='Load the registers with random values, instead of all 0s.')
@@ -349,7 +472,105 @@ if __name__ == '__main__':
     parser.add_argument('-c', '--cond',
                         action='store_true',
                         help='Set cpsr flags to match instruction condition code.')
+    parser.add_argument('-o', '--order',
+                        type=str, nargs=1,
+                        help='Search order: linear, bitrev, stratified or a '
+                             'comma-separated bit priority list.',
+                        metavar='ORDER', default=None)
+    parser.add_argument('-M', '--result-map',
+                        type=str, nargs=1,
+                        help='Record the result of every instruction in a (shared) result map.',
+                        metavar='FILE', default=None)
+    parser.add_argument('-R', '--rle-map',
+                        action='store_true',
+                        help='Record the result of every instruction in per-worker RLE maps.')
+    parser.add_argument('--diff-exec',
+                        type=str, nargs=1,
+                        help='Also execute every instruction with CMD (e.g. '
+                             '"qemu-aarch64 ./fuzzer"), and log differing results.',
+                        metavar='CMD', default=None)
+    parser.add_argument('--repeat',
+                        type=int, nargs=1,
+                        help='Re-execute hidden instructions N times, and log the '
+                             'distribution of results.',
+                        metavar='N', default=None)
+    parser.add_argument('--rotate-cpus',
+                        action='store_true',
+                        help='Spread the repeated runs over all CPUs.')
+    parser.add_argument('--timeout',
+                        type=int, nargs=1,
+                        help='Time limit per instruction in ms (0 disables it).',
+                        metavar='MS', default=None)
+    parser.add_argument('--sandbox',
+                        action='store_true',
+                        help='Point the registers into a scratch arena, and log '
+                             'the memory written by hidden instructions.')
+    parser.add_argument('--seccomp',
+                        action='store_true',
+                        help='Trap syscalls made by executed instructions, '
+                             'without ptrace.')
+    parser.add_argument('--page-regs',
+                        action='store_true',
+                        help='Log register values without ptrace.')
+    parser.add_argument('--timing',
+                        type=int, nargs=1,
+                        help='Measure the latency of every executed instruction '
+                             'over RUNS runs, and flag outliers.',
+                        metavar='RUNS', default=None)
+    parser.add_argument('--timing-perf',
+                        action='store_true',
+                        help='Measure the latency in CPU cycles with perf.')
+    parser.add_argument('--perf-stats',
+                        action='store_true',
+                        help='Log perf counters and time per region of encodings.')
+    parser.add_argument('--async-log',
+                        action='store_true',
+                        help='Write the log of hidden instructions in a separate '
+                             'thread.')
+    parser.add_argument('--summary',
+                        action='store_true',
+                        help='Group the hidden instructions by behaviour.')
+    parser.add_argument('--summary-only',
+                        action='store_true',
+                        help='Group the hidden instructions by behaviour, without '
+                             'logging them individually.')
+    parser.add_argument('--disas-cache',
+                        action='store_true',
+                        help='Skip disassembling encodings of instructions '
+                             'already found to be defined.')
+    parser.add_argument('--no-capstone',
+                        action='store_true',
+                        help='Classify the instructions with libopcodes only.')
+    parser.add_argument('--compat',
+                        type=str, nargs=1,
+                        help='On AArch64: Fuzz A32/T32 by executing the instructions '
+                             'with a 32-bit CMD (e.g. "./fuzzer32").',
+                        metavar='CMD', default=None)
+    parser.add_argument('--cpus',
+                        type=str, nargs=1,
+                        help='Comma-separated list of CPUs to pin the workers to.',
+                        metavar='LIST', default=None)
+    parser.add_argument('--per-cluster',
+                        action='store_true',
+                        help='Search the range once on each core type (by MIDR), '
+                             'and compare the results.')
 
     args = parser.parse_args()
+    if args.per_cluster and (args.cpus or args.result_map):
+        parser.error('--per-cluster can\'t be combined with --cpus or -M')
+    if args.rotate_cpus and (args.cpus or args.per_cluster):
+        parser.error('--rotate-cpus can\'t be combined with --cpus or --per-cluster')
+    if args.seccomp and args.ptrace:
+        parser.error('--seccomp can\'t be combined with -p')
+    if args.page_regs and args.ptrace:
+        parser.error('--page-regs can\'t be combined with -p')
+    if args.timing and (args.ptrace or args.diff_exec or args.compat):
+        parser.error('--timing can\'t be combined with -p, --diff-exec or --compat')
+    if args.no_capstone and args.discreps:
+        parser.error('--no-capstone can\'t be combined with -d')
+    if args.disas_cache and args.compat:
+        parser.error('--disas-cache can\'t be combined with --compat')
+    if args.compat and (args.diff_exec or args.repeat or args.rle_map):
+        parser.error('--compat can\'t be combined with --diff-exec, --repeat or -R')
     quit_str = curses.wrapper(main, args)
     print(quit_str)
@@ -0,0 +1,48 @@
+#pragma once
+#include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "logging.h"
+
+#define ASYNC_LOG_RING_SIZE 1024
+
+typedef struct {
+    execution_result result;
+    bool write_regs;
+    bool only_reg_changes;
+    bool include_vector_regs;
+    // Makes the writer thread quit
+    bool stop;
+} async_log_entry;
+
+/*
+ * Single-producer/single-consumer ring between the executing thread and
+ * the writer thread of --async-log. Each side owns its own index, and the
+ * slots are handed over with two counting semaphores, which only enter
+ * the kernel when a side has to wait (the writer when the ring is empty,
+ * the executor when it's full).
+ */
+typedef struct {
+    int fd;
+    pthread_t thread;
+    // Only accessed by the writer, which formats the lines into buf
+    FILE *mem_fp;
+    char *buf;
+    size_t length;
+    // Slots filled by the executor, and slots free for it
+    sem_t used;
+    sem_t free;
+    // Only accessed by the executor
+    uint32_t head;
+    // Only accessed by the writer
+    uint32_t tail;
+    // Set by the writer if a write failed
+    atomic_bool failed;
+    async_log_entry ring[ASYNC_LOG_RING_SIZE];
+} async_logger;
+
+int start_async_logger(async_logger*, const char*);
+void async_log_result(async_logger*, execution_result*, bool, bool, bool);
+int stop_async_logger(async_logger*);
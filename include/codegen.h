@@ -0,0 +1,37 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Options the page execution boilerplate is specialised for. Code that
+ * isn't needed for the active options isn't emitted at all.
+ */
+typedef struct {
+    // AArch32 only: Emit Thumb code, for testing T32 instructions
+    bool thumb;
+    // Store the registers after execution to the third argument
+    bool spill_regs;
+    // Store the virtual counter ticks the instruction took to the fourth
+    bool timing;
+} boilerplate_config;
+
+/*
+ * The emitted boilerplate is called as
+ *
+ *   void boilerplate(uintptr_t reg_init, uintptr_t flags,
+ *                    struct USER_REGS_TYPE *regs_after, uint64_t *ticks);
+ *
+ * where every register (including sp) is set to reg_init before the tested
+ * instruction is executed, and the condition flags are set to flags
+ * (bits 31-28), which is 0 unless they are set to match the condition code
+ * (-c, AArch32 only). Thumb boilerplates are called at their address + 1.
+ */
+typedef struct {
+    // Length of the boilerplate, in bytes
+    uint32_t length;
+    // Offset of the (4-byte) slot of the instruction to be tested
+    uint32_t insn_offset;
+} boilerplate_layout;
+
+int emit_boilerplate(void*, size_t, boilerplate_config*, boilerplate_layout*);
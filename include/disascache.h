@@ -0,0 +1,40 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define DISAS_CACHE_BITS 16
+#define DISAS_CACHE_SIZE (1 << DISAS_CACHE_BITS)
+#define DISAS_CACHE_MAX_MASKS 32
+
+/*
+ * Cache of the A64 encodings libopcodes has found to be defined, for
+ * --disas-cache.
+ *
+ * An entry covers a whole encoding class: the decoded opcode with all of
+ * its plain register operand fields free. The class is stored as the
+ * encoding with those fields cleared, and the operand mask it was cleared
+ * with. As only a few distinct operand masks exist (Rd, Rd+Rn, Rt+Rn+Rt2,
+ * ...), a lookup tries each of them, starting with the last one that hit.
+ */
+typedef struct {
+    // Distinct operand masks seen so far
+    uint32_t masks[DISAS_CACHE_MAX_MASKS];
+    uint32_t mask_count;
+    uint32_t last_mask;
+
+    // Direct-mapped; mask_idx is the index into masks + 1, or 0 if unused
+    uint32_t keys[DISAS_CACHE_SIZE];
+    uint8_t mask_idx[DISAS_CACHE_SIZE];
+
+    uint64_t hits;
+    uint64_t misses;
+    // Defined encodings whose class can't be cached
+    uint64_t uncacheable;
+} disas_cache;
+
+bool disas_cache_supported(void);
+void init_disas_cache(disas_cache*);
+bool lookup_disas_cache(disas_cache*, uint32_t);
+void add_disas_cache(disas_cache*, uint32_t);
+void print_disas_cache_stats(disas_cache*, FILE*);
@@ -2,4 +2,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-bool filter_instruction(uint32_t insn, bool thumb, uint32_t filter_level);
+// Number of consecutive encodings filter_block handles at once
+#define FILTER_BLOCK_SIZE 64
+
+uint64_t filter_block(uint32_t first, uint32_t count, bool aarch32,
+                      bool thumb, uint32_t filter_level);
+bool filter_instruction(uint32_t insn, bool aarch32, bool thumb,
+                        uint32_t filter_level, bool dense);
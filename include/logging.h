@@ -1,6 +1,7 @@
 #pragma once
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include "reg_const.h"
 
 typedef struct {
@@ -13,8 +14,24 @@ typedef struct {
     uint64_t hidden_instructions_found;
     uint64_t disas_discrepancies;
     uint64_t instructions_per_sec;
+    // Encodings of the traversal before insn, to resume from with --skip
+    uint64_t visited;
 } search_status;
 
+#ifndef __aarch64__
+// Names of the uregs
+extern const char *REG_STR[];
+#endif
+
+// Changed memory ranges recorded per instruction by --sandbox
+#define MAX_MEM_CHANGES 8
+
+typedef struct {
+    // Relative to the register base
+    int32_t offset;
+    uint32_t length;
+} mem_change;
+
 typedef struct {
     struct USER_REGS_TYPE regs_before;
     struct USER_REGS_TYPE regs_after;
@@ -25,10 +42,50 @@ typedef struct {
     uint32_t insn;
     uint32_t signal;
     bool died;
+    // Killed by the watchdog (--timeout)
+    bool timed_out;
+
+    // si_code and si_addr of the signal, if signal is non-zero
+    int32_t sig_code;
+    uint64_t sig_addr;
+    // Number of the trapped syscall, for SIGSYS
+    int32_t syscall;
+    // Latency of the execution with --timing, in counter ticks or cycles
+    uint64_t ticks;
+
+    // Register base with --sandbox, 0 otherwise
+    uint64_t sandbox_base;
+    uint32_t mem_change_count;
+    mem_change mem_changes[MAX_MEM_CHANGES];
+    // Changed bytes that didn't fit in mem_changes
+    uint32_t mem_bytes_dropped;
 } execution_result;
 
+// Distinct signals/register outcomes tracked per instruction by --repeat
+#define REPEAT_MAX_OUTCOMES 8
+
+typedef struct {
+    uint32_t insn;
+    uint32_t runs;
+    uint32_t signal_count;
+    int32_t signals[REPEAT_MAX_OUTCOMES];
+    uint32_t signal_runs[REPEAT_MAX_OUTCOMES];
+    uint32_t outcome_count;
+    uint64_t outcomes[REPEAT_MAX_OUTCOMES];
+    uint32_t outcome_runs[REPEAT_MAX_OUTCOMES];
+    // Runs that didn't fit in the tables above
+    uint32_t other_runs;
+} repeat_tally;
+
+bool si_addr_is_valid(int, int);
+bool si_addr_is_data(int);
+void write_si_code(FILE*, int, int);
+
 void print_statusline(search_status*);
 void print_execution_result(execution_result*, bool);
 
 int write_statusfile(char*, search_status*);
+void write_log_entry(FILE*, execution_result*, bool, bool, bool);
 int write_logfile(char*, execution_result*, bool, bool, bool);
+int write_divergence(char*, execution_result*, execution_result*, bool, bool);
+int write_repeat_tally(char*, repeat_tally*, bool);
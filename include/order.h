@@ -0,0 +1,42 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef enum {
+    ORDER_LINEAR,
+    ORDER_BITREV,
+    ORDER_STRATIFIED,
+    ORDER_CUSTOM,
+} order_type;
+
+typedef struct {
+    order_type type;
+    // Only used by ORDER_CUSTOM: bit positions, fastest-changing first
+    uint8_t bits[32];
+    uint32_t bit_count;
+} insn_order;
+
+typedef struct {
+    insn_order order;
+    uint32_t range_start;
+    uint32_t range_end;
+    uint64_t mask;
+    bool thumb;
+
+    // Linear traversal state
+    uint64_t next;
+
+    // Permuted traversal state
+    uint32_t fixed_bits;
+    uint8_t bit_map[32];
+    uint32_t bit_count;
+    uint64_t counter;
+} insn_iterator;
+
+int parse_insn_order(const char*, insn_order*);
+void init_insn_iterator(insn_iterator*, insn_order*, uint32_t, uint32_t,
+                        uint64_t, bool);
+bool insn_iterator_is_dense(insn_iterator*, uint32_t);
+bool next_insn(insn_iterator*, uint32_t*);
+uint64_t skip_insns(insn_iterator*, uint64_t);
+uint64_t get_next_instruction(uint64_t, uint64_t, bool);
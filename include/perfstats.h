@@ -0,0 +1,37 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "logging.h"
+
+enum {
+    PERF_STAT_CYCLES,
+    PERF_STAT_INSTRUCTIONS,
+    PERF_STAT_CONTEXT_SWITCHES,
+    PERF_STAT_PAGE_FAULTS,
+    PERF_STAT_L1I_MISSES,
+    PERF_STAT_COUNT
+};
+
+/*
+ * Per-worker counters of --perf-stats. Counters the kernel or CPU doesn't
+ * support (e.g. the hardware ones under QEMU) have an fd of -1, and are
+ * logged as "-".
+ */
+typedef struct {
+    FILE *fp;
+    int fds[PERF_STAT_COUNT];
+    // Counter values and search status at the start of the region
+    uint64_t start[PERF_STAT_COUNT];
+    uint64_t start_utime_us;
+    uint64_t start_stime_us;
+    search_status start_status;
+
+    // Accumulated by the fuzzer over the region
+    uint64_t disas_ns;
+    uint64_t exec_ns;
+} perf_stats;
+
+int open_perf_stats(perf_stats*, const char*);
+int write_perf_region(perf_stats*, uint32_t, uint32_t, search_status*);
+int close_perf_stats(perf_stats*);
@@ -0,0 +1,73 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "logging.h"
+
+#define REMOTE_MAGIC 0x41524d53
+#define REMOTE_BATCH_SIZE 256
+
+#define REMOTE_FLAG_PTRACE      (1 << 0)
+#define REMOTE_FLAG_THUMB       (1 << 1)
+#define REMOTE_FLAG_RANDOM_REGS (1 << 2)
+#define REMOTE_FLAG_VECTOR_REGS (1 << 3)
+#define REMOTE_FLAG_SET_COND    (1 << 4)
+#define REMOTE_FLAG_SANDBOX     (1 << 5)
+#define REMOTE_FLAG_SECCOMP     (1 << 6)
+#define REMOTE_FLAG_PAGE_REGS   (1 << 7)
+// Reply with remote_results instead of execution_results
+#define REMOTE_FLAG_COMPACT     (1 << 8)
+
+/*
+ * Sent to the executor when it starts, and echoed back (with the
+ * executor's own result size) to make sure both sides agree on the
+ * format of execution_result.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t result_size;
+    uint32_t flags;
+    uint32_t timeout_ms;
+    uint64_t seed;
+} remote_config;
+
+/*
+ * The part of execution_result that doesn't depend on the ISA the
+ * executor is built for, with the same layout on AArch32 and AArch64.
+ * Used by --compat, where an AArch64 fuzzer drives a 32-bit executor.
+ */
+typedef struct {
+    uint32_t insn;
+    uint32_t signal;
+    uint8_t died;
+    uint8_t timed_out;
+    uint16_t padding;
+    int32_t sig_code;
+    uint64_t sig_addr;
+    int32_t syscall;
+    uint32_t mem_change_count;
+    uint64_t sandbox_base;
+    mem_change mem_changes[MAX_MEM_CHANGES];
+    uint32_t mem_bytes_dropped;
+    uint32_t padding2;
+} remote_result;
+
+typedef struct {
+    pid_t pid;
+    int to_fd;
+    int from_fd;
+    // The executor replies with remote_results (REMOTE_FLAG_COMPACT)
+    bool compact;
+} remote_executor;
+
+int spawn_remote_executor(remote_executor*, const char*, remote_config*);
+int remote_submit_batch(remote_executor*, uint32_t*, uint32_t);
+int remote_collect_results(remote_executor*, execution_result*, uint32_t);
+void stop_remote_executor(remote_executor*);
+
+int read_remote_config(int, remote_config*);
+int write_remote_config(int, remote_config*);
+int read_remote_batch(int, uint32_t*, uint32_t*);
+int write_remote_results(int, execution_result*, uint32_t, bool);
+
+bool results_diverge(execution_result*, execution_result*, bool, bool);
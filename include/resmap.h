@@ -0,0 +1,60 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RESULT_MAP_MAGIC "ARMSHKRM"
+#define RESULT_MAP_VERSION 1
+#define RESULT_MAP_HEADER_SIZE 4096
+#define RESULT_MAP_BITS_PER_ENTRY 4
+#define RESULT_MAP_ENTRY_COUNT 0x100000000
+#define RESULT_MAP_SIZE (RESULT_MAP_HEADER_SIZE + RESULT_MAP_ENTRY_COUNT / 2)
+
+#define RESULT_MAP_ISA_A64 1
+#define RESULT_MAP_ISA_A32 2
+#define RESULT_MAP_ISA_T32 3
+
+/*
+ * The outcome of a single instruction encoding. Stored as a nibble
+ * per encoding in the result map, so there is room for 16 classes.
+ */
+typedef enum {
+    RESULT_UNVISITED = 0,
+    RESULT_SKIPPED = 1,
+    RESULT_FILTERED = 2,
+    RESULT_UNEXECUTED = 3,
+    RESULT_SIGILL = 4,
+    RESULT_SIGSEGV = 5,
+    RESULT_SIGTRAP = 6,
+    RESULT_SIGBUS = 7,
+    RESULT_NO_SIGNAL = 8,
+    RESULT_OTHER_SIGNAL = 9,
+    RESULT_TIMEOUT = 10,
+    // Trapped syscall (SIGSYS), with --seccomp
+    RESULT_SYSCALL = 11,
+    RESULT_CLASS_COUNT
+} result_class;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t bits_per_entry;
+    uint32_t isa;
+} result_map_header;
+
+typedef struct {
+    int fd;
+    uint8_t *mapping;
+    size_t mapping_length;
+    // File offset of the first mapped byte
+    uint64_t mapping_offset;
+} result_map;
+
+result_class result_class_from_signal(int);
+const char *result_class_name(result_class);
+
+int open_result_map(result_map*, const char*, uint32_t, uint32_t, uint32_t);
+int read_result_map_header(int, result_map_header*);
+void set_result(result_map*, uint32_t, result_class);
+result_class get_result(result_map*, uint32_t);
+void close_result_map(result_map*);
@@ -0,0 +1,81 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "resmap.h"
+
+#define RLE_MAP_MAGIC "ARMSHKRL"
+#define RLE_MAP_FOOTER_MAGIC "ARMSHKRI"
+#define RLE_MAP_VERSION 1
+
+// Every RLE_INDEX_STRIDE-th record is included in the index
+#define RLE_INDEX_STRIDE 256
+
+/*
+ * An RLE map is a sorted list of non-overlapping runs of encodings with
+ * the same result class. Encodings not covered by any run are unvisited.
+ *
+ * File layout:
+ *   rle_map_header
+ *   rle_record[record_count]
+ *   uint32_t index[index_count]   (first insn of every stride-th record)
+ *   rle_map_footer
+ *
+ * The index and footer are written when the map is closed. A map without
+ * them (e.g. from a crashed worker) is still readable, as the index is
+ * then rebuilt from the records.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t isa;
+} rle_map_header;
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t class;
+} rle_record;
+
+typedef struct {
+    uint64_t record_count;
+    uint32_t index_stride;
+    uint32_t index_count;
+    char magic[8];
+} rle_map_footer;
+
+typedef struct {
+    FILE *fp;
+    bool run_active;
+    rle_record run;
+    uint64_t record_count;
+    uint32_t *index;
+    uint32_t index_count;
+    uint32_t index_capacity;
+} rle_writer;
+
+typedef struct {
+    int fd;
+    uint32_t isa;
+    uint64_t record_count;
+    uint32_t *index;
+    uint32_t index_count;
+
+    // Sequential read state
+    rle_record *buf;
+    uint64_t buf_first_record;
+    uint32_t buf_count;
+    uint64_t next_record;
+} rle_reader;
+
+int open_rle_writer(rle_writer*, const char*, uint32_t);
+int rle_append(rle_writer*, uint32_t, result_class);
+int rle_append_run(rle_writer*, rle_record*);
+int flush_rle_writer(rle_writer*);
+int close_rle_writer(rle_writer*);
+
+int open_rle_reader(rle_reader*, const char*);
+int rle_next(rle_reader*, rle_record*);
+int rle_seek(rle_reader*, uint32_t);
+result_class rle_lookup(rle_reader*, uint32_t);
+void close_rle_reader(rle_reader*);
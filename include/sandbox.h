@@ -0,0 +1,35 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "logging.h"
+
+// Size of the scratch arena, excluding the guard pages
+#define SANDBOX_ARENA_SIZE 0x10000
+
+/*
+ * A scratch arena surrounded by PROT_NONE guard pages. The registers are
+ * pointed at the middle of the arena (the base), so that loads and stores
+ * with small offsets from any register end up in the arena.
+ *
+ * The arena is filled with a known pattern, where every 32-bit word holds
+ * SANDBOX_PATTERN_TAG in the upper half and its word index in the lower
+ * half, so that loaded values also reveal where they were loaded from.
+ *
+ * The mapping is shared, so a ptrace slave forked after the arena was
+ * created writes to the same memory as the fuzzer sees.
+ */
+#define SANDBOX_PATTERN_TAG 0x5a5a0000
+
+typedef struct {
+    uint8_t *mapping;
+    size_t mapping_length;
+    uint8_t *arena;
+    uintptr_t base;
+} scratch_arena;
+
+int init_scratch_arena(scratch_arena*);
+void find_arena_changes(scratch_arena*, execution_result*);
+void free_scratch_arena(scratch_arena*);
+
+int install_syscall_trap(void*, size_t);
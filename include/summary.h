@@ -0,0 +1,64 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "logging.h"
+
+// Value-transform classes of the changed general purpose registers
+#define TRANSFORM_ZERO  (1 << 0)
+#define TRANSFORM_ONES  (1 << 1)
+#define TRANSFORM_SMALL (1 << 2)
+#define TRANSFORM_COPY  (1 << 3)
+#define TRANSFORM_OTHER (1 << 4)
+
+#define SUMMARY_MAX_SIGNATURES 4096
+#define SUMMARY_MAX_GROUPS 64
+
+/*
+ * What a hidden instruction did, independent of its operand bits. The
+ * register fields are only set when the registers were captured (-p or
+ * --page-regs). Compared with memcmp, so it's zeroed before it's filled.
+ */
+typedef struct {
+    int32_t signal;
+    int32_t sig_code;
+    uint8_t timed_out;
+    uint8_t wrote_mem;
+    uint8_t fp_status_changed;
+    uint8_t transforms;
+    uint32_t vregs_changed;
+    // Bit i is uregs[i] (AArch32) or x<i>, with sp and pstate as 31 and 32
+    uint64_t regs_changed;
+    int64_t pc_delta;
+} hit_signature;
+
+// Encodings matching value in the bits set in mask
+typedef struct {
+    uint32_t value;
+    uint32_t mask;
+    uint64_t count;
+} hit_group;
+
+typedef struct {
+    bool used;
+    hit_signature sig;
+    uint64_t count;
+    uint32_t group_count;
+    hit_group *groups;
+} signature_entry;
+
+typedef struct {
+    // Open addressing, with room for twice the maximum signatures
+    signature_entry entries[SUMMARY_MAX_SIGNATURES * 2];
+    uint32_t signature_count;
+    uint64_t hits;
+    // Hits whose signature didn't fit in the table
+    uint64_t dropped;
+    // Hits added since the summary was last written
+    bool dirty;
+} hit_summary;
+
+void init_hit_summary(hit_summary*);
+void add_hit(hit_summary*, execution_result*, bool, bool);
+int write_hit_summary(hit_summary*, const char*);
+void free_hit_summary(hit_summary*);
@@ -0,0 +1,47 @@
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Executed encodings on each side an encoding is compared against
+#define TIMING_NEIGHBOURS 4
+#define TIMING_WINDOW (2 * TIMING_NEIGHBOURS + 1)
+
+// Upper bound of --timing
+#define TIMING_MAX_RUNS 4096
+
+/*
+ * Latency distribution (in counter ticks or cycles, minus the baseline)
+ * of one encoding, over all its runs.
+ */
+typedef struct {
+    uint32_t insn;
+    uint64_t min;
+    uint64_t q1;
+    uint64_t median;
+    uint64_t q3;
+    uint64_t max;
+} timing_entry;
+
+/*
+ * The timing log is written with a delay of TIMING_NEIGHBOURS entries, as
+ * every entry is compared with the executed encodings on both sides of it.
+ */
+typedef struct {
+    FILE *fp;
+    uint64_t baseline;
+    timing_entry window[TIMING_WINDOW];
+    uint32_t window_count;
+    // Entries added, and entries written out
+    uint64_t added;
+    uint64_t written;
+} timing_log;
+
+int open_timing_log(timing_log*, const char*, const char*, uint64_t,
+                    uint32_t, uint64_t);
+int add_timing(timing_log*, uint32_t, uint64_t*, uint32_t);
+int close_timing_log(timing_log*);
+
+uint64_t read_counter_frequency(void);
+int open_cycle_counter(void);
+uint64_t read_cycle_counter(int);
@@ -3,3 +3,4 @@
 #include <stdbool.h>
 
 bool is_thumb32(uint32_t insn);
+uint64_t read_midr(int cpu);
@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include "asynclog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Formatted lines are written out when this much is buffered
+#define ASYNC_LOG_FLUSH_SIZE 0x10000
+
+static void wait_sem(sem_t *sem)
+{
+    while (sem_wait(sem) == -1 && errno == EINTR);
+}
+
+/*
+ * Writes the buffered lines with a single append, so that they don't
+ * interleave with the lines the executing thread still writes itself
+ * (e.g. discrepancies).
+ */
+static int write_batch(int fd, char *buf, size_t length)
+{
+    while (length > 0) {
+        ssize_t ret = write(fd, buf, length);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        buf += ret;
+        length -= ret;
+    }
+    return 0;
+}
+
+static void *writer_thread(void *arg)
+{
+    async_logger *logger = arg;
+    FILE *mem_fp = logger->mem_fp;
+
+    for (;;) {
+        // Write out what's buffered before waiting for more
+        if (sem_trywait(&logger->used) == -1) {
+            fflush(mem_fp);
+            if (logger->length > 0) {
+                if (write_batch(logger->fd, logger->buf, logger->length) == -1)
+                    atomic_store(&logger->failed, true);
+                rewind(mem_fp);
+            }
+            wait_sem(&logger->used);
+        }
+
+        async_log_entry *entry = &logger->ring[logger->tail];
+        logger->tail = (logger->tail + 1) % ASYNC_LOG_RING_SIZE;
+        if (entry->stop)
+            break;
+
+        write_log_entry(mem_fp, &entry->result, entry->write_regs,
+                        entry->only_reg_changes, entry->include_vector_regs);
+        sem_post(&logger->free);
+
+        if (ftell(mem_fp) >= ASYNC_LOG_FLUSH_SIZE) {
+            fflush(mem_fp);
+            if (write_batch(logger->fd, logger->buf, logger->length) == -1)
+                atomic_store(&logger->failed, true);
+            rewind(mem_fp);
+        }
+    }
+
+    fflush(mem_fp);
+    if (logger->length > 0
+            && write_batch(logger->fd, logger->buf, logger->length) == -1)
+        atomic_store(&logger->failed, true);
+    fclose(mem_fp);
+    free(logger->buf);
+    return NULL;
+}
+
+/*
+ * Opens the log at path for appending, and starts the writer thread.
+ *
+ * The writer thread blocks all signals, so that the signals of the
+ * execution (and the SIGALRM of --timeout) are delivered to the executing
+ * thread. It must be started after the ptrace slave is forked.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int start_async_logger(async_logger *logger, const char *path)
+{
+    logger->fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (logger->fd == -1)
+        return -1;
+
+    // Created here rather than by the writer, so that a failure is reported
+    logger->buf = NULL;
+    logger->length = 0;
+    logger->mem_fp = open_memstream(&logger->buf, &logger->length);
+    if (logger->mem_fp == NULL) {
+        close(logger->fd);
+        return -1;
+    }
+
+    logger->head = 0;
+    logger->tail = 0;
+    atomic_init(&logger->failed, false);
+    if (sem_init(&logger->used, 0, 0) == -1
+            || sem_init(&logger->free, 0, ASYNC_LOG_RING_SIZE) == -1) {
+        fclose(logger->mem_fp);
+        free(logger->buf);
+        close(logger->fd);
+        return -1;
+    }
+
+    sigset_t all_signals, old_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_mask);
+    int ret = pthread_create(&logger->thread, NULL, writer_thread, logger);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (ret != 0) {
+        errno = ret;
+        sem_destroy(&logger->used);
+        sem_destroy(&logger->free);
+        fclose(logger->mem_fp);
+        free(logger->buf);
+        close(logger->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static async_log_entry *claim_slot(async_logger *logger)
+{
+    // Waits for the writer if the ring is full
+    wait_sem(&logger->free);
+    async_log_entry *entry = &logger->ring[logger->head];
+    logger->head = (logger->head + 1) % ASYNC_LOG_RING_SIZE;
+    return entry;
+}
+
+/*
+ * Queues the log line of a hidden instruction, like write_logfile.
+ */
+void async_log_result(async_logger *logger, execution_result *result,
+                      bool write_regs, bool only_reg_changes,
+                      bool include_vector_regs)
+{
+    async_log_entry *entry = claim_slot(logger);
+    entry->result = *result;
+    entry->write_regs = write_regs;
+    entry->only_reg_changes = only_reg_changes;
+    entry->include_vector_regs = include_vector_regs;
+    entry->stop = false;
+    sem_post(&logger->used);
+}
+
+/*
+ * Writes the queued lines, and stops the writer thread.
+ *
+ * Returns 0 on success and -1 if any of the lines couldn't be written.
+ */
+int stop_async_logger(async_logger *logger)
+{
+    async_log_entry *entry = claim_slot(logger);
+    entry->stop = true;
+    sem_post(&logger->used);
+
+    pthread_join(logger->thread, NULL);
+    sem_destroy(&logger->used);
+    sem_destroy(&logger->free);
+
+    int ret = close(logger->fd);
+    return ret == 0 && !atomic_load(&logger->failed) ? 0 : -1;
+}
@@ -0,0 +1,540 @@
+#include "codegen.h"
+#include "reg_const.h"
+#include <stddef.h>
+
+/*
+ * Generates the page execution boilerplate at runtime, directly as
+ * instruction words, so that it only contains what the active options
+ * need. The CPSR flags are passed as an argument, so the code never has to
+ * be patched for an instruction (apart from the instruction itself).
+ */
+
+typedef struct {
+    uint8_t *code;
+    // In bytes
+    size_t capacity;
+    size_t length;
+} emitter;
+
+static void emit_bytes(emitter *e, uint32_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (e->length < e->capacity)
+            e->code[e->length] = (value >> (i * 8)) & 0xff;
+        ++e->length;
+    }
+}
+
+static void emit(emitter *e, uint32_t insn)
+{
+    emit_bytes(e, insn, 4);
+}
+
+#ifdef __aarch64__
+
+#define A64_SP 31
+#define A64_XZR 31
+#define A64_LR 30
+
+// stp xt1, xt2, [xn, #imm]!
+static uint32_t a64_stp_pre(uint32_t t1, uint32_t t2, uint32_t n, int32_t imm)
+{
+    return 0xa9800000 | ((imm / 8) & 0x7f) << 15 | t2 << 10 | n << 5 | t1;
+}
+
+// ldp xt1, xt2, [xn], #imm
+static uint32_t a64_ldp_post(uint32_t t1, uint32_t t2, uint32_t n, int32_t imm)
+{
+    return 0xa8c00000 | ((imm / 8) & 0x7f) << 15 | t2 << 10 | n << 5 | t1;
+}
+
+// stp xt1, xt2, [xn, #imm]
+static uint32_t a64_stp(uint32_t t1, uint32_t t2, uint32_t n, int32_t imm)
+{
+    return 0xa9000000 | ((imm / 8) & 0x7f) << 15 | t2 << 10 | n << 5 | t1;
+}
+
+// str xt, [xn, #imm]
+static uint32_t a64_str(uint32_t t, uint32_t n, uint32_t imm)
+{
+    return 0xf9000000 | (imm / 8) << 10 | n << 5 | t;
+}
+
+// mov xd, xm
+static uint32_t a64_mov(uint32_t d, uint32_t m)
+{
+    return 0xaa0003e0 | m << 16 | d;
+}
+
+// add xd, xn, #0 (i.e. mov to/from sp)
+static uint32_t a64_mov_sp(uint32_t d, uint32_t n)
+{
+    return 0x91000000 | n << 5 | d;
+}
+
+// mov vd.d[index], xn
+static uint32_t a64_ins_d(uint32_t d, uint32_t index, uint32_t n)
+{
+    return 0x4e081c00 | index << 20 | n << 5 | d;
+}
+
+// mov xd, vn.d[index]
+static uint32_t a64_umov_d(uint32_t d, uint32_t n, uint32_t index)
+{
+    return 0x4e083c00 | index << 20 | n << 5 | d;
+}
+
+// fmov dd, xn
+static uint32_t a64_fmov_to_d(uint32_t d, uint32_t n)
+{
+    return 0x9e670000 | n << 5 | d;
+}
+
+// fmov xd, dn
+static uint32_t a64_fmov_from_d(uint32_t d, uint32_t n)
+{
+    return 0x9e660000 | n << 5 | d;
+}
+
+// sub xd, xn, xm
+static uint32_t a64_sub(uint32_t d, uint32_t n, uint32_t m)
+{
+    return 0xcb000000 | m << 16 | n << 5 | d;
+}
+
+// mrs xt, cntvct_el0
+static uint32_t a64_mrs_cntvct(uint32_t t)
+{
+    return 0xd53be040 | t;
+}
+
+// mrs xt, nzcv
+static uint32_t a64_mrs_nzcv(uint32_t t)
+{
+    return 0xd53b4200 | t;
+}
+
+// msr nzcv, xt
+static uint32_t a64_msr_nzcv(uint32_t t)
+{
+    return 0xd51b4200 | t;
+}
+
+#define A64_NOP 0xd503201f
+#define A64_ISB 0xd5033fdf
+#define A64_RET 0xd65f03c0
+
+/*
+ * The stack pointer is kept in v0.d[0], and the regs_after pointer in
+ * v0.d[1], while the tested instruction executes. All gregs are stored on
+ * the stack, so the registers can be reset freely.
+ *
+ * With timing, the virtual counter is read into d2 before the registers are
+ * reset, and into d3 right after the tested instruction. The difference is
+ * stored to the fourth argument once the gregs (including x3) are restored.
+ */
+static void emit_a64(emitter *e, boilerplate_config *config,
+                     boilerplate_layout *layout)
+{
+    // Store all gregs (x0 is the first argument, so the pair order matters)
+    for (uint32_t i = 0; i < 30; i += 2)
+        emit(e, a64_stp_pre(i, i + 1, A64_SP, -16));
+    emit(e, a64_stp_pre(A64_LR, A64_XZR, A64_SP, -16));
+
+    // Store the stack pointer
+    emit(e, a64_mov_sp(A64_LR, A64_SP));
+    emit(e, a64_ins_d(0, 0, A64_LR));
+    if (config->spill_regs)
+        emit(e, a64_ins_d(0, 1, 2));
+
+    // The flags are passed in x1, so they are loaded before the reset
+    emit(e, a64_msr_nzcv(1));
+
+    if (config->timing) {
+        emit(e, A64_ISB);
+        emit(e, a64_mrs_cntvct(1));
+        emit(e, a64_fmov_to_d(2, 1));
+    }
+
+    /*
+     * Reset the regs to make insn execution deterministic and avoid
+     * program corruption, to the value passed in x0.
+     */
+    for (uint32_t i = 1; i <= 30; ++i)
+        emit(e, a64_mov(i, 0));
+    emit(e, a64_mov_sp(A64_SP, A64_LR));
+
+    // This instruction will be replaced with the one to be tested
+    layout->insn_offset = e->length;
+    emit(e, A64_NOP);
+
+    if (config->timing) {
+        // x0 is parked in d1 while the counter is read
+        emit(e, a64_fmov_to_d(1, 0));
+        emit(e, A64_ISB);
+        emit(e, a64_mrs_cntvct(0));
+        emit(e, a64_fmov_to_d(3, 0));
+        emit(e, a64_fmov_from_d(0, 1));
+    }
+
+    if (config->spill_regs) {
+        // x0 is parked in d1 while it's used as the base register
+        emit(e, a64_fmov_to_d(1, 0));
+        emit(e, a64_umov_d(0, 0, 1));
+        for (uint32_t i = 1; i < 30; i += 2)
+            emit(e, a64_stp(i, i + 1, 0,
+                            offsetof(struct user_regs_struct, regs[i])));
+        emit(e, a64_fmov_from_d(1, 1));
+        emit(e, a64_str(1, 0, offsetof(struct user_regs_struct, regs[0])));
+        emit(e, a64_mov_sp(1, A64_SP));
+        emit(e, a64_str(1, 0, offsetof(struct user_regs_struct, sp)));
+        emit(e, a64_mrs_nzcv(1));
+        emit(e, a64_str(1, 0, offsetof(struct user_regs_struct, pstate)));
+    }
+
+    // Restore the stack pointer
+    emit(e, a64_umov_d(A64_LR, 0, 0));
+    emit(e, a64_mov_sp(A64_SP, A64_LR));
+
+    // Restore all gregs
+    emit(e, a64_ldp_post(A64_LR, A64_XZR, A64_SP, 16));
+    for (int32_t i = 28; i >= 0; i -= 2)
+        emit(e, a64_ldp_post(i, i + 1, A64_SP, 16));
+
+    // x9 and x10 are caller-saved, so they can be used here
+    if (config->timing) {
+        emit(e, a64_fmov_from_d(9, 2));
+        emit(e, a64_fmov_from_d(10, 3));
+        emit(e, a64_sub(9, 10, 9));
+        emit(e, a64_str(9, 3, 0));
+    }
+
+    emit(e, A64_RET);
+}
+
+#else
+
+#define A32_COND_AL 0xe0000000
+
+static void emit_t16(emitter *e, uint16_t insn)
+{
+    emit_bytes(e, insn, 2);
+}
+
+// 32-bit thumb instructions are stored as two half-words, upper one first
+static void emit_t32(emitter *e, uint32_t insn)
+{
+    emit_t16(e, insn >> 16);
+    emit_t16(e, insn & 0xffff);
+}
+
+// mov rd, rm
+static uint32_t a32_mov(uint32_t d, uint32_t m)
+{
+    return A32_COND_AL | 0x01a00000 | d << 12 | m;
+}
+
+// vmov sn, rt
+static uint32_t a32_vmov_to_s(uint32_t n, uint32_t t)
+{
+    return A32_COND_AL | 0x0e000a10 | (n >> 1) << 16 | t << 12 | (n & 1) << 7;
+}
+
+// vmov rt, sn
+static uint32_t a32_vmov_from_s(uint32_t t, uint32_t n)
+{
+    return A32_COND_AL | 0x0e100a10 | (n >> 1) << 16 | t << 12 | (n & 1) << 7;
+}
+
+// vmov dm, rt, rt2
+static uint32_t a32_vmov_to_d(uint32_t m, uint32_t t, uint32_t t2)
+{
+    return A32_COND_AL | 0x0c400b10 | t2 << 16 | t << 12 | m;
+}
+
+// vmov rt, rt2, dm
+static uint32_t a32_vmov_from_d(uint32_t t, uint32_t t2, uint32_t m)
+{
+    return A32_COND_AL | 0x0c500b10 | t2 << 16 | t << 12 | m;
+}
+
+// mrrc p15, 1, rt, rt2, c14 (i.e. read CNTVCT)
+static uint32_t a32_mrrc_cntvct(uint32_t t, uint32_t t2)
+{
+    return A32_COND_AL | 0x0c500f1e | t2 << 16 | t << 12;
+}
+
+// subs rd, rn, rm
+static uint32_t a32_subs(uint32_t d, uint32_t n, uint32_t m)
+{
+    return A32_COND_AL | 0x00500000 | n << 16 | d << 12 | m;
+}
+
+// sbc rd, rn, rm
+static uint32_t a32_sbc(uint32_t d, uint32_t n, uint32_t m)
+{
+    return A32_COND_AL | 0x00c00000 | n << 16 | d << 12 | m;
+}
+
+// str rt, [rn, #imm]
+static uint32_t a32_str(uint32_t t, uint32_t n, uint32_t imm)
+{
+    return A32_COND_AL | 0x05800000 | n << 16 | t << 12 | imm;
+}
+
+#define A32_PUSH_R0_R12_LR  (A32_COND_AL | 0x092d5fff)
+#define A32_POP_R0_R12_LR   (A32_COND_AL | 0x08bd5fff)
+// stmib r0, {r1-r14}
+#define A32_STMIB_R0_R1_R14 (A32_COND_AL | 0x09807ffe)
+// msr cpsr_f, r1
+#define A32_MSR_CPSR_F_R1   (A32_COND_AL | 0x0128f001)
+// mrs r1, cpsr
+#define A32_MRS_R1_CPSR     (A32_COND_AL | 0x010f1000)
+#define A32_NOP             (A32_COND_AL | 0x0320f000)
+#define A32_ISB             0xf57ff06f
+#define A32_BX_LR           (A32_COND_AL | 0x012fff1e)
+
+// The T32 encodings of vmov and mrrc are the A32 ones with the AL condition
+#define t32_vmov_to_s a32_vmov_to_s
+#define t32_vmov_from_s a32_vmov_from_s
+#define t32_vmov_to_d a32_vmov_to_d
+#define t32_vmov_from_d a32_vmov_from_d
+#define t32_mrrc_cntvct a32_mrrc_cntvct
+
+// mov rd, rm (16-bit, any registers)
+static uint16_t t16_mov(uint32_t d, uint32_t m)
+{
+    return 0x4600 | (d >> 3) << 7 | m << 3 | (d & 7);
+}
+
+// str.w rt, [rn, #imm]
+static uint32_t t32_str(uint32_t t, uint32_t n, uint32_t imm)
+{
+    return 0xf8c00000 | n << 16 | t << 12 | imm;
+}
+
+// subs.w rd, rn, rm
+static uint32_t t32_subs(uint32_t d, uint32_t n, uint32_t m)
+{
+    return 0xebb00000 | n << 16 | d << 8 | m;
+}
+
+// sbc.w rd, rn, rm
+static uint32_t t32_sbc(uint32_t d, uint32_t n, uint32_t m)
+{
+    return 0xeb600000 | n << 16 | d << 8 | m;
+}
+
+#define T32_PUSH_R0_R12_LR  0xe92d5fff
+#define T32_POP_R0_R12_LR   0xe8bd5fff
+// msr cpsr_f, r1
+#define T32_MSR_CPSR_F_R1   0xf3818800
+// mrs r1, cpsr
+#define T32_MRS_R1_CPSR     0xf3ef8100
+#define T32_NOP_W           0xf3af8000
+#define T32_ISB             0xf3bf8f6f
+#define T16_NOP             0xbf00
+#define T16_BX_LR           0x4770
+
+// Nops after the tested instruction, so that an IT instruction can't make
+// any of the boilerplate conditional
+#define T16_IT_PADDING 4
+
+/*
+ * The stack pointer is kept in s0, and the regs_after pointer in s1,
+ * while the tested instruction executes. It's better to use ptrace in
+ * cases where the sp might be corrupted, but storing the sp in a vector
+ * reg mitigates the issue somewhat.
+ *
+ * With timing, CNTVCT is read into d2 before the registers are reset, and
+ * into d4 right after the tested instruction (with r0 and r1 parked in
+ * d3). The difference is stored to the fourth argument once the gregs
+ * (including r3) are restored.
+ */
+static void emit_a32(emitter *e, boilerplate_config *config,
+                     boilerplate_layout *layout)
+{
+    // Store all gregs
+    emit(e, A32_PUSH_R0_R12_LR);
+    emit(e, a32_vmov_to_s(0, A32_sp));
+    if (config->spill_regs)
+        emit(e, a32_vmov_to_s(1, A32_r2));
+
+    // The flags are passed in r1, so they are loaded before the reset
+    emit(e, A32_MSR_CPSR_F_R1);
+
+    if (config->timing) {
+        emit(e, A32_ISB);
+        emit(e, a32_mrrc_cntvct(A32_r1, A32_r2));
+        emit(e, a32_vmov_to_d(2, A32_r1, A32_r2));
+    }
+
+    /*
+     * Reset the regs to make insn execution deterministic and avoid
+     * program corruption, to the value passed in r0.
+     */
+    for (uint32_t i = A32_r1; i <= A32_lr; ++i)
+        emit(e, a32_mov(i, A32_r0));
+
+    // This instruction will be replaced with the one to be tested
+    layout->insn_offset = e->length;
+    emit(e, A32_NOP);
+
+    if (config->timing) {
+        emit(e, a32_vmov_to_d(3, A32_r0, A32_r1));
+        emit(e, A32_ISB);
+        emit(e, a32_mrrc_cntvct(A32_r0, A32_r1));
+        emit(e, a32_vmov_to_d(4, A32_r0, A32_r1));
+        emit(e, a32_vmov_from_d(A32_r0, A32_r1, 3));
+    }
+
+    if (config->spill_regs) {
+        // r0 is parked in s2 while it's used as the base register
+        emit(e, a32_vmov_to_s(2, A32_r0));
+        emit(e, a32_vmov_from_s(A32_r0, 1));
+        emit(e, A32_STMIB_R0_R1_R14);
+        emit(e, a32_vmov_from_s(A32_r1, 2));
+        emit(e, a32_str(A32_r1, A32_r0, A32_r0 * 4));
+        emit(e, A32_MRS_R1_CPSR);
+        emit(e, a32_str(A32_r1, A32_r0, A32_cpsr * 4));
+    }
+
+    emit(e, a32_vmov_from_s(A32_sp, 0));
+
+    // Restore all gregs
+    emit(e, A32_POP_R0_R12_LR);
+
+    // r0-r2 and ip are caller-saved, so they can be used here
+    if (config->timing) {
+        emit(e, a32_vmov_from_d(A32_r0, A32_r1, 2));
+        emit(e, a32_vmov_from_d(A32_r2, A32_ip, 4));
+        emit(e, a32_subs(A32_r0, A32_r2, A32_r0));
+        emit(e, a32_sbc(A32_r1, A32_ip, A32_r1));
+        emit(e, a32_str(A32_r0, A32_r3, 0));
+        emit(e, a32_str(A32_r1, A32_r3, 4));
+    }
+
+    emit(e, A32_BX_LR);
+}
+
+/*
+ * Same as emit_a32, but in Thumb. The boilerplate has to be entered with
+ * the interworking bit set (i.e. at the address + 1).
+ *
+ * The tested instruction gets a 4-byte slot, so 16-bit instructions are
+ * followed by a 16-bit nop (as in ptrace execution). Thumb can't move the
+ * sp to a vector register directly, or store it with stm, so ip is used as
+ * an intermediate.
+ */
+static void emit_t32_boilerplate(emitter *e, boilerplate_config *config,
+                                 boilerplate_layout *layout)
+{
+    // Store all gregs
+    emit_t32(e, T32_PUSH_R0_R12_LR);
+    emit_t16(e, t16_mov(A32_ip, A32_sp));
+    emit_t32(e, t32_vmov_to_s(0, A32_ip));
+    if (config->spill_regs)
+        emit_t32(e, t32_vmov_to_s(1, A32_r2));
+
+    // The flags are passed in r1, so they are loaded before the reset
+    emit_t32(e, T32_MSR_CPSR_F_R1);
+
+    if (config->timing) {
+        emit_t32(e, T32_ISB);
+        emit_t32(e, t32_mrrc_cntvct(A32_r1, A32_r2));
+        emit_t32(e, t32_vmov_to_d(2, A32_r1, A32_r2));
+    }
+
+    /*
+     * Reset the regs to make insn execution deterministic and avoid
+     * program corruption, to the value passed in r0.
+     */
+    for (uint32_t i = A32_r1; i <= A32_lr; ++i)
+        emit_t16(e, t16_mov(i, A32_r0));
+
+    // Word align the slot, as pc-relative instructions use Align(pc, 4)
+    if (e->length % 4 != 0)
+        emit_t16(e, T16_NOP);
+
+    // This instruction will be replaced with the one to be tested
+    layout->insn_offset = e->length;
+    emit_t32(e, T32_NOP_W);
+    for (uint32_t i = 0; i < T16_IT_PADDING; ++i)
+        emit_t16(e, T16_NOP);
+
+    if (config->timing) {
+        emit_t32(e, t32_vmov_to_d(3, A32_r0, A32_r1));
+        emit_t32(e, T32_ISB);
+        emit_t32(e, t32_mrrc_cntvct(A32_r0, A32_r1));
+        emit_t32(e, t32_vmov_to_d(4, A32_r0, A32_r1));
+        emit_t32(e, t32_vmov_from_d(A32_r0, A32_r1, 3));
+    }
+
+    if (config->spill_regs) {
+        // r0 is parked in s2 while it's used as the base register
+        emit_t32(e, t32_vmov_to_s(2, A32_r0));
+        emit_t32(e, t32_vmov_from_s(A32_r0, 1));
+        for (uint32_t i = A32_r1; i <= A32_lr; ++i) {
+            if (i != A32_sp)
+                emit_t32(e, t32_str(i, A32_r0, i * 4));
+        }
+        emit_t32(e, t32_vmov_from_s(A32_r1, 2));
+        emit_t32(e, t32_str(A32_r1, A32_r0, A32_r0 * 4));
+        emit_t16(e, t16_mov(A32_r1, A32_sp));
+        emit_t32(e, t32_str(A32_r1, A32_r0, A32_sp * 4));
+        emit_t32(e, T32_MRS_R1_CPSR);
+        emit_t32(e, t32_str(A32_r1, A32_r0, A32_cpsr * 4));
+    }
+
+    emit_t32(e, t32_vmov_from_s(A32_ip, 0));
+    emit_t16(e, t16_mov(A32_sp, A32_ip));
+
+    // Restore all gregs
+    emit_t32(e, T32_POP_R0_R12_LR);
+
+    if (config->timing) {
+        emit_t32(e, t32_vmov_from_d(A32_r0, A32_r1, 2));
+        emit_t32(e, t32_vmov_from_d(A32_r2, A32_ip, 4));
+        emit_t32(e, t32_subs(A32_r0, A32_r2, A32_r0));
+        emit_t32(e, t32_sbc(A32_r1, A32_ip, A32_r1));
+        emit_t32(e, t32_str(A32_r0, A32_r3, 0));
+        emit_t32(e, t32_str(A32_r1, A32_r3, 4));
+    }
+
+    emit_t16(e, T16_BX_LR);
+}
+
+#endif
+
+/*
+ * Writes the boilerplate for the given options to code, which has room for
+ * capacity bytes, and describes where the tested instruction goes in
+ * layout.
+ *
+ * Returns 0 on success and -1 if the code doesn't fit.
+ */
+int emit_boilerplate(void *code, size_t capacity, boilerplate_config *config,
+                     boilerplate_layout *layout)
+{
+    emitter e = {
+        .code = code,
+        .capacity = capacity,
+    };
+
+#ifdef __aarch64__
+    if (config->thumb)
+        return -1;
+    emit_a64(&e, config, layout);
+#else
+    if (config->thumb)
+        emit_t32_boilerplate(&e, config, layout);
+    else
+        emit_a32(&e, config, layout);
+#endif
+
+    if (e.length > capacity)
+        return -1;
+
+    layout->length = e.length;
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "disascache.h"
+#include <string.h>
+
+#ifndef SHARED_LIBOPCODES
+/*
+ * Defines needed for bfd "bug":
+ * https://github.com/mlpack/mlpack/issues/574
+ */
+#define PACKAGE
+#define PACKAGE_VERSION
+#include "../binutils/opcodes/aarch64-opc.h"
+
+/*
+ * Returns the bits of a plain register operand, which libopcodes decodes
+ * without any checks (every value is a valid register), or 0 for any other
+ * operand type.
+ */
+static uint32_t register_operand_mask(enum aarch64_opnd type)
+{
+    switch (type) {
+        case AARCH64_OPND_Rd:
+        case AARCH64_OPND_Rd_SP:
+        case AARCH64_OPND_Rt:
+        case AARCH64_OPND_Fd:
+        case AARCH64_OPND_Ft:
+        case AARCH64_OPND_Sd:
+        case AARCH64_OPND_Vd:
+            return 0x1f;
+        case AARCH64_OPND_Rn:
+        case AARCH64_OPND_Rn_SP:
+        case AARCH64_OPND_Fn:
+        case AARCH64_OPND_Sn:
+        case AARCH64_OPND_Vn:
+            return 0x1f << 5;
+        case AARCH64_OPND_Rt2:
+        case AARCH64_OPND_Ra:
+        case AARCH64_OPND_Fa:
+        case AARCH64_OPND_Ft2:
+        case AARCH64_OPND_Va:
+            return 0x1f << 10;
+        case AARCH64_OPND_Rm:
+        case AARCH64_OPND_Rs:
+        case AARCH64_OPND_Fm:
+        case AARCH64_OPND_Sm:
+        case AARCH64_OPND_Vm:
+            return 0x1f << 16;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Returns the bits read by the common operands that don't list their fields
+ * in the operand table (their extractors use fixed ones), or 0 if unknown.
+ */
+static uint32_t unlisted_operand_fields(enum aarch64_opnd type)
+{
+    switch (type) {
+        case AARCH64_OPND_ADDR_SIMPLE:
+            return 0x1f << 5;                           // Rn
+        case AARCH64_OPND_Rm_SFT:
+            return 0x1f << 16 | 0x3 << 22 | 0x3f << 10; // Rm, shift, imm6
+        case AARCH64_OPND_Rm_EXT:
+            return 0x1f << 16 | 0x7 << 13 | 0x7 << 10;  // Rm, option, imm3
+        case AARCH64_OPND_ADDR_REGOFF:
+            return 0x1f << 5 | 0x1f << 16 | 0xf << 12;  // Rn, Rm, option, S
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Returns the bits that can be changed without changing whether the
+ * encoding is defined, or 0 if there are none (or they can't be told).
+ *
+ * The decoder picks the opcode by the fixed bits alone, so every encoding
+ * matching them decodes to the same opcode (or one before it), unless the
+ * opcode has extra checks. Opcodes with a verifier, constraints or a tied
+ * operand, as well as fields shared with another operand, are therefore
+ * not cached.
+ */
+static uint32_t operand_mask(uint32_t insn)
+{
+    aarch64_inst inst;
+    aarch64_operand_error errors;
+    if (aarch64_decode_insn(insn, &inst, TRUE, &errors) != ERR_OK)
+        return 0;
+
+    const aarch64_opcode *opcode = inst.opcode;
+    if (opcode->verifier != NULL || opcode->constraints != 0
+            || opcode->tied_operand != 0)
+        return 0;
+
+    uint32_t mask = 0;
+    uint32_t other_fields = 0;
+    for (int i = 0; i < AARCH64_MAX_OPND_NUM
+                    && opcode->operands[i] != AARCH64_OPND_NIL; ++i) {
+        uint32_t reg_mask = register_operand_mask(opcode->operands[i]);
+        if (reg_mask != 0) {
+            mask |= reg_mask;
+            continue;
+        }
+
+        const aarch64_operand *operand = &aarch64_operands[opcode->operands[i]];
+        if (operand->fields[0] == FLD_NIL) {
+            // Others without fields of their own (e.g. the second register
+            // of a pair) may depend on any bits
+            uint32_t unlisted = unlisted_operand_fields(opcode->operands[i]);
+            if (unlisted == 0)
+                return 0;
+            other_fields |= unlisted;
+            continue;
+        }
+        for (int j = 0; j < 5 && operand->fields[j] != FLD_NIL; ++j) {
+            const aarch64_field *field = &fields[operand->fields[j]];
+            other_fields |= ((1u << field->width) - 1) << field->lsb;
+        }
+    }
+
+    if ((mask & opcode->mask) != 0 || (mask & other_fields) != 0)
+        return 0;
+
+    return mask;
+}
+
+bool disas_cache_supported(void)
+{
+    return true;
+}
+#else
+// The tables of a shared libopcodes aren't part of its interface
+static uint32_t operand_mask(uint32_t insn)
+{
+    (void)insn;
+    return 0;
+}
+
+bool disas_cache_supported(void)
+{
+    return false;
+}
+#endif
+
+static inline uint32_t slot(uint32_t key, uint32_t mask_idx)
+{
+    return ((key ^ mask_idx) * 0x9e3779b1u) >> (32 - DISAS_CACHE_BITS);
+}
+
+void init_disas_cache(disas_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+/*
+ * Returns whether insn is in a cached (defined) encoding class.
+ */
+bool lookup_disas_cache(disas_cache *cache, uint32_t insn)
+{
+    // Linear sweeps stay in the same class for a while, so try the
+    // last mask that hit first
+    for (uint32_t n = 0; n < cache->mask_count; ++n) {
+        uint32_t i = (cache->last_mask + n) % cache->mask_count;
+        uint32_t key = insn & ~cache->masks[i];
+        uint32_t s = slot(key, i + 1);
+        if (cache->mask_idx[s] == i + 1 && cache->keys[s] == key) {
+            cache->last_mask = i;
+            ++cache->hits;
+            return true;
+        }
+    }
+
+    ++cache->misses;
+    return false;
+}
+
+/*
+ * Adds the encoding class of insn, which libopcodes found to be defined.
+ */
+void add_disas_cache(disas_cache *cache, uint32_t insn)
+{
+    uint32_t mask = operand_mask(insn);
+    if (mask == 0) {
+        ++cache->uncacheable;
+        return;
+    }
+
+    uint32_t i;
+    for (i = 0; i < cache->mask_count; ++i) {
+        if (cache->masks[i] == mask)
+            break;
+    }
+    if (i == cache->mask_count) {
+        if (cache->mask_count == DISAS_CACHE_MAX_MASKS) {
+            ++cache->uncacheable;
+            return;
+        }
+        cache->masks[cache->mask_count++] = mask;
+    }
+
+    uint32_t key = insn & ~mask;
+    uint32_t s = slot(key, i + 1);
+    cache->keys[s] = key;
+    cache->mask_idx[s] = i + 1;
+}
+
+void print_disas_cache_stats(disas_cache *cache, FILE *fp)
+{
+    uint64_t lookups = cache->hits + cache->misses;
+    fprintf(fp, "disassembly cache: %llu hits, %llu misses (%.1f%% hit rate), "
+                "%llu uncacheable, %u operand masks\n",
+            (unsigned long long)cache->hits,
+            (unsigned long long)cache->misses,
+            lookups > 0 ? 100.0 * cache->hits / lookups : 0.0,
+            (unsigned long long)cache->uncacheable, cache->mask_count);
+}
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <signal.h>
 #include <ucontext.h>
+#include <setjmp.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <malloc.h>
@@ -21,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <elf.h>
+#include <sched.h>
 
 #ifdef USE_CAPSTONE
 #include <capstone/capstone.h>
@@ -34,9 +36,20 @@
 #define PACKAGE_VERSION
 #include <dis-asm.h>
 
+#include "asynclog.h"
+#include "codegen.h"
+#include "disascache.h"
 #include "filter.h"
 #include "logging.h"
+#include "order.h"
+#include "perfstats.h"
+#include "remote.h"
 #include "reg_const.h"
+#include "resmap.h"
+#include "sandbox.h"
+#include "summary.h"
+#include "rlemap.h"
+#include "timing.h"
 #include "util.h"
 
 #define STATUS_UPDATE_RATE 0x1000
@@ -46,21 +59,50 @@
 
 #define PAGE_SIZE 4096
 
-#ifdef USE_CAPSTONE
+#define DEFAULT_TIMEOUT_MS 1000
+
+// Hidden instructions collected before re-executing them with --repeat
+#define REPEAT_BATCH_SIZE 64
+
+/*
+ * A32/T32 instructions can only be executed by a 32-bit executor
+ * (--compat) on AArch64.
+ */
 #ifdef __aarch64__
-    #define CAPSTONE_ARCH CS_ARCH_ARM64
+#define NATIVE_AARCH32 false
 #else
-    #define CAPSTONE_ARCH CS_ARCH_ARM
-#endif
+#define NATIVE_AARCH32 true
 #endif
 
-// Increment bits in x indicated by the mask m
-#define MASKED_INCREMENT(x, m) ((x & ~m) | (((x | ~m) + 1) & m))
-
 void *insn_page;
 volatile sig_atomic_t last_insn_signum = 0;
 volatile sig_atomic_t executing_insn = 0;
+volatile sig_atomic_t last_insn_si_code = 0;
+volatile uintptr_t last_insn_si_addr = 0;
+volatile sig_atomic_t last_insn_syscall = 0;
+volatile uintptr_t last_insn_pc = 0;
 uint32_t insn_offset = 0;
+// Cycle counter of --timing-perf (-1 if unused)
+int timing_perf_fd = -1;
+// Writer thread of --async-log (NULL if unused)
+async_logger *async_log = NULL;
+// Behaviour summary of --summary (NULL if unused)
+hit_summary *hit_sum = NULL;
+// --summary-only: Don't log the hidden instructions individually
+bool summary_only = false;
+
+/*
+ * Watchdog state. exec_generation is incremented for every execution, so
+ * the watchdog can tell whether the same execution has been running for
+ * a whole timer period. The generations are unsigned so that they wrap
+ * (sig_atomic_t is a signed int), and aligned 32-bit accesses are atomic.
+ */
+volatile uint32_t exec_generation = 0;
+volatile uint32_t watchdog_generation = 0;
+volatile sig_atomic_t watchdog_expired = 0;
+// The ptrace slave to kill on timeout (0 in page execution)
+volatile sig_atomic_t watchdog_pid = 0;
+static sigjmp_buf watchdog_env;
 
 static uint8_t *sig_stack_array = NULL;
 stack_t sig_stack = {
@@ -68,18 +110,77 @@ stack_t sig_stack = {
     .ss_sp = NULL,
 };
 
+/*
+ * Everything needed to execute an instruction, independent of whether it is
+ * executed in-process or on a ptrace slave.
+ */
+typedef struct {
+    // A32/T32 instructions (always set on AArch32)
+    bool aarch32;
+    bool use_ptrace;
+    bool thumb;
+    bool random_regs;
+    bool vector_regs;
+    bool set_cond;
+    time_t seed;
+    pid_t slave_pid;
+    // 0 disables the watchdog
+    uint32_t timeout_ms;
+    // Trap syscalls issued from the instruction page (page execution only)
+    bool use_seccomp;
+    // Capture the registers after execution in page execution too
+    bool page_regs;
+    // Measure the latency of every execution (page execution only)
+    bool timing;
+    // Measure it with perf cycles instead of the virtual counter
+    bool timing_perf;
+    bool use_sandbox;
+    // Scratch arena, set up by init_exec_backend if use_sandbox is set
+    scratch_arena *sandbox;
+} exec_config;
+
+#ifdef USE_CAPSTONE
+// Number of consecutive encodings capstone_classify_block handles at once
+#define CAPSTONE_BLOCK_SIZE 64
+
+/*
+ * Capstone handle, with a single instruction that every disassembly
+ * reuses, and the classification of the last block of encodings.
+ */
+typedef struct {
+    csh handle;
+    cs_insn *insn;
+    bool thumb;
+    // Classify whole blocks (see capstone_defined)
+    bool use_blocks;
+    bool block_valid;
+    uint32_t block_first;
+    uint64_t block_defined;
+} capstone_state;
+#endif
+
 void signal_handler(int, siginfo_t*, void*);
 void init_signal_handler(void (*handler)(int, siginfo_t*, void*), int);
-void execution_boilerplate(void);
-int init_insn_page(void);
-void execute_insn_page(uint8_t*, size_t, bool, execution_result*);
+void watchdog_handler(int, siginfo_t*, void*);
+int init_watchdog(uint32_t);
+int init_insn_page(boilerplate_config*);
+void execute_insn_page(uint8_t*, size_t, bool, bool, uintptr_t, bool,
+                       execution_result*);
 uint8_t cond_code_to_flags(uint8_t);
 uint64_t get_nano_timestamp(void);
+int disas_vsprintf(void*, const char*, va_list);
 int disas_sprintf(void*, const char*, ...);
+#ifdef DISASM_INIT_STYLED
+int disas_styled_sprintf(void*, enum disassembler_style, const char*, ...);
+#endif
 size_t fill_insn_buffer(uint8_t*, size_t, uint32_t, bool);
-int libopcodes_disassemble(uint32_t, bool, char*, size_t);
+int libopcodes_disassemble(uint32_t, bool, bool, char*, size_t);
 #ifdef USE_CAPSTONE
-int capstone_disassemble(uint32_t, bool, char*, size_t, csh*);
+int open_capstone(capstone_state*, bool, bool, bool);
+void close_capstone(capstone_state*);
+int capstone_disassemble(capstone_state*, uint32_t, char*, size_t);
+uint64_t capstone_classify_block(capstone_state*, uint32_t, uint32_t);
+bool capstone_defined(capstone_state*, uint32_t);
 #endif
 void slave_loop(void);
 void slave_loop_thumb(void);
@@ -89,21 +190,39 @@ int custom_ptrace_setregs(pid_t, struct USER_REGS_TYPE*);
 int custom_ptrace_getvfpregs(pid_t, struct USER_VFPREGS_TYPE*);
 int custom_ptrace_setvfpregs(pid_t, struct USER_VFPREGS_TYPE*);
 void execute_insn_slave(pid_t*, uint8_t*, size_t, bool, bool, bool, bool,
-                        execution_result*);
+                        uintptr_t, execution_result*);
 bool is_thumb32(uint32_t);
-uint64_t get_next_instruction(uint64_t, uint64_t, bool);
+void record_result(result_map*, rle_writer*, uint32_t, result_class);
+result_class get_result_class(execution_result*);
+int log_hidden_insn(char*, execution_result*, bool, bool, bool);
+int init_exec_backend(exec_config*);
+bool captures_regs(exec_config*);
+void execute_insn(exec_config*, uint32_t, execution_result*);
+int run_exec_server(void);
+int execute_diff_batch(remote_executor*, exec_config*, uint32_t*, uint32_t,
+                       char*, search_status*, result_map*);
+int execute_compat_batch(remote_executor*, uint32_t*, uint32_t, char*,
+                         search_status*, result_map*);
+void write_exec_header(FILE*, exec_config*);
+bool parse_exec_header(const char*, exec_config*);
+int run_replay(char*, char*, exec_config*, bool);
+void tally_result(repeat_tally*, execution_result*, bool, bool);
+int pin_executor(exec_config*, cpu_set_t*);
+void repeat_hits(exec_config*, uint32_t*, uint32_t, uint32_t, cpu_set_t*,
+                 char*);
+uint64_t measure_timing_baseline(exec_config*, uint32_t);
+void time_insn(exec_config*, uint32_t, uint64_t, uint64_t*, uint32_t);
 void print_help(char*);
 
-extern char boilerplate_start, boilerplate_end, insn_location;
-
 void signal_handler(int sig_num, siginfo_t *sig_info, void *uc_ptr)
 {
-    // Suppress unused warning
-    (void)sig_info;
-
     ucontext_t* uc = (ucontext_t*) uc_ptr;
 
     last_insn_signum = sig_num;
+    last_insn_si_code = sig_info->si_code;
+    last_insn_si_addr = (uintptr_t)sig_info->si_addr;
+    if (sig_num == SIGSYS)
+        last_insn_syscall = sig_info->si_syscall;
 
     if (executing_insn == 0) {
         // Something other than a hidden insn execution raised the signal,
@@ -112,12 +231,14 @@ void signal_handler(int sig_num, siginfo_t *sig_info, void *uc_ptr)
         exit(1);
     }
 
-    // Jump to the next instruction (i.e. skip the illegal insn)
-    uintptr_t insn_skip = (uintptr_t)(insn_page) + (insn_offset+1)*4;
+    // Jump past the instruction slot (i.e. skip the illegal insn)
+    uintptr_t insn_skip = (uintptr_t)(insn_page) + insn_offset + 4;
 
 #ifdef __aarch64__
+    last_insn_pc = uc->uc_mcontext.pc;
     uc->uc_mcontext.pc = insn_skip;
 #else
+    last_insn_pc = uc->uc_mcontext.arm_pc;
     uc->uc_mcontext.arm_pc = insn_skip;
 #endif
 }
@@ -137,169 +258,78 @@ void init_signal_handler(void (*handler)(int, siginfo_t*, void*), int signum)
 }
 
 /*
- * State management when testing instructions.
- *
- * Used to prevent instructions with side-effects to corrupt the program
- * state, in addition to saving register values for analysis.
+ * Called periodically by the watchdog timer. If the same execution has been
+ * running for a whole period, the instruction is considered hanging: the
+ * ptrace slave is killed, or in page execution, the execution is unwound
+ * back to execute_insn_page.
  */
-void execution_boilerplate(void)
+void watchdog_handler(int sig_num, siginfo_t *sig_info, void *uc_ptr)
 {
-#ifdef __aarch64__
-    asm volatile(
-            ".global boilerplate_start  \n"
-            "boilerplate_start:         \n"
-
-            // Store all gregs
-            "stp x0, x1, [sp, #-16]!    \n"
-            "stp x2, x3, [sp, #-16]!    \n"
-            "stp x4, x5, [sp, #-16]!    \n"
-            "stp x6, x7, [sp, #-16]!    \n"
-            "stp x8, x9, [sp, #-16]!    \n"
-            "stp x10, x11, [sp, #-16]!  \n"
-            "stp x12, x13, [sp, #-16]!  \n"
-            "stp x14, x15, [sp, #-16]!  \n"
-            "stp x16, x17, [sp, #-16]!  \n"
-            "stp x18, x19, [sp, #-16]!  \n"
-            "stp x20, x21, [sp, #-16]!  \n"
-            "stp x22, x23, [sp, #-16]!  \n"
-            "stp x24, x25, [sp, #-16]!  \n"
-            "stp x26, x27, [sp, #-16]!  \n"
-            "stp x28, x29, [sp, #-16]!  \n"
-            "stp x30, xzr, [sp, #-16]!  \n"
-
-            // Store the stack pointer
-            "mov x30, sp                \n"
-            "mov v0.2d[0], x30          \n"
+    // Suppress unused warnings
+    (void)sig_num;
+    (void)sig_info;
+    (void)uc_ptr;
 
-            /*
-             * Reset the regs to make insn execution deterministic
-             * and avoid program corruption.
-             */
-            "mov x0, %[reg_init]        \n"
-            "mov x1, %[reg_init]        \n"
-            "mov x2, %[reg_init]        \n"
-            "mov x3, %[reg_init]        \n"
-            "mov x4, %[reg_init]        \n"
-            "mov x5, %[reg_init]        \n"
-            "mov x6, %[reg_init]        \n"
-            "mov x7, %[reg_init]        \n"
-            "mov x8, %[reg_init]        \n"
-            "mov x9, %[reg_init]        \n"
-            "mov x10, %[reg_init]       \n"
-            "mov x11, %[reg_init]       \n"
-            "mov x12, %[reg_init]       \n"
-            "mov x13, %[reg_init]       \n"
-            "mov x14, %[reg_init]       \n"
-            "mov x15, %[reg_init]       \n"
-            "mov x16, %[reg_init]       \n"
-            "mov x17, %[reg_init]       \n"
-            "mov x18, %[reg_init]       \n"
-            "mov x19, %[reg_init]       \n"
-            "mov x20, %[reg_init]       \n"
-            "mov x21, %[reg_init]       \n"
-            "mov x22, %[reg_init]       \n"
-            "mov x23, %[reg_init]       \n"
-            "mov x24, %[reg_init]       \n"
-            "mov x25, %[reg_init]       \n"
-            "mov x26, %[reg_init]       \n"
-            "mov x27, %[reg_init]       \n"
-            "mov x28, %[reg_init]       \n"
-            "mov x29, %[reg_init]       \n"
-            "mov x30, %[reg_init]       \n"
-            "mov sp, x30                \n"
-
-            ".global insn_location      \n"
-            "insn_location:             \n"
-
-            // This instruction will be replaced with the one to be tested
-            "nop                        \n"
-
-            // Restore the stack pointer
-            "mov x30, v0.2d[0]          \n"
-            "mov sp, x30                \n"
-
-            // Restore all gregs
-            "ldp x30, xzr, [sp], #16    \n"
-            "ldp x28, x29, [sp], #16    \n"
-            "ldp x26, x27, [sp], #16    \n"
-            "ldp x24, x25, [sp], #16    \n"
-            "ldp x22, x23, [sp], #16    \n"
-            "ldp x20, x21, [sp], #16    \n"
-            "ldp x18, x19, [sp], #16    \n"
-            "ldp x16, x17, [sp], #16    \n"
-            "ldp x14, x15, [sp], #16    \n"
-            "ldp x12, x13, [sp], #16    \n"
-            "ldp x10, x11, [sp], #16    \n"
-            "ldp x8, x9, [sp], #16      \n"
-            "ldp x6, x7, [sp], #16      \n"
-            "ldp x4, x5, [sp], #16      \n"
-            "ldp x2, x3, [sp], #16      \n"
-            "ldp x0, x1, [sp], #16      \n"
-
-            "ret                        \n"
-            ".global boilerplate_end    \n"
-            "boilerplate_end:           \n"
-            :
-            : [reg_init] "n" (0)
-            );
-#else
-    asm volatile(
-            ".global boilerplate_start  \n"
-            "boilerplate_start:         \n"
+    if (!executing_insn || exec_generation != watchdog_generation) {
+        watchdog_generation = exec_generation;
+        return;
+    }
 
-            // Store all gregs
-            "push {r0-r12, lr}          \n"
+    watchdog_expired = 1;
 
-            /*
-             * It's better to use ptrace in cases where the sp might
-             * be corrupted, but storing the sp in a vector reg
-             * mitigates the issue somewhat.
-             */
-            "vmov s0, sp                \n"
-
-            // Reset the regs to make insn execution deterministic
-            // and avoid program corruption
-            "mov r0, %[reg_init]        \n"
-            "mov r1, %[reg_init]        \n"
-            "mov r2, %[reg_init]        \n"
-            "mov r3, %[reg_init]        \n"
-            "mov r4, %[reg_init]        \n"
-            "mov r5, %[reg_init]        \n"
-            "mov r6, %[reg_init]        \n"
-            "mov r7, %[reg_init]        \n"
-            "mov r8, %[reg_init]        \n"
-            "mov r9, %[reg_init]        \n"
-            "mov r10, %[reg_init]       \n"
-            "mov r11, %[reg_init]       \n"
-            "mov r12, %[reg_init]       \n"
-            "mov lr, %[reg_init]        \n"
-            "mov sp, %[reg_init]        \n"
-
-            // Note: this msr insn must be directly above the nop
-            // because of the -c option (excluding the label ofc)
-            "msr cpsr_f, #0             \n"
-
-            ".global insn_location      \n"
-            "insn_location:             \n"
-
-            // This instruction will be replaced with the one to be tested
-            "nop                        \n"
-
-            "vmov sp, s0                \n"
-
-            // Restore all gregs
-            "pop {r0-r12, lr}           \n"
-
-            "bx lr                      \n"
-            ".global boilerplate_end    \n"
-            "boilerplate_end:           \n"
-            :
-            : [reg_init] "n" (0)
-            );
-#endif
+    if (watchdog_pid != 0)
+        kill(watchdog_pid, SIGKILL);
+    else
+        siglongjmp(watchdog_env, 1);
+}
+
+/*
+ * Starts a periodic timer, rather than arming a timer for every execution,
+ * to keep the syscalls out of the execution loop. A hanging instruction is
+ * therefore caught after between one and two periods.
+ */
+int init_watchdog(uint32_t timeout_ms)
+{
+    /*
+     * Unlike for the other signals, nothing is blocked while handling the
+     * timer, as siglongjmp (without restoring the signal mask) would leave
+     * the blocked signals blocked after unwinding.
+     */
+    struct sigaction s = {
+        .sa_sigaction = watchdog_handler,
+        .sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART | SA_NODEFER,
+    };
+    sigemptyset(&s.sa_mask);
+
+    if (sigaction(SIGALRM, &s, NULL) == -1)
+        return -1;
+
+    struct sigevent sev = {
+        .sigev_notify = SIGEV_SIGNAL,
+        .sigev_signo = SIGALRM,
+    };
+    timer_t timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer) == -1)
+        return -1;
+
+    struct itimerspec period = {
+        .it_interval = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_nsec = (timeout_ms % 1000) * 1000000,
+        },
+    };
+    period.it_value = period.it_interval;
+    return timer_settime(timer, 0, &period, NULL);
 }
 
-int init_insn_page(void)
+/*
+ * State management when testing instructions: maps the instruction page
+ * and generates the boilerplate around the tested instruction.
+ *
+ * Used to prevent instructions with side-effects to corrupt the program
+ * state, in addition to saving register values for analysis.
+ */
+int init_insn_page(boilerplate_config *config)
 {
     // Allocate an executable page / memory region
     insn_page = mmap(NULL,
@@ -312,55 +342,110 @@ int init_insn_page(void)
     if (insn_page == MAP_FAILED)
         return 1;
 
-    uint32_t boilerplate_length = (&boilerplate_end - &boilerplate_start) / 4;
-
-    // Load the boilerplate assembly
-    for (uint32_t i = 0; i < boilerplate_length; ++i)
-        ((uint32_t*)insn_page)[i] = ((uint32_t*)&boilerplate_start)[i];
+    boilerplate_layout layout;
+    if (emit_boilerplate(insn_page, PAGE_SIZE, config, &layout) == -1) {
+        errno = ENOMEM;
+        return 1;
+    }
+    insn_offset = layout.insn_offset;
 
-    insn_offset = (&insn_location - &boilerplate_start) / 4;
+    __clear_cache(insn_page, insn_page + layout.length);
 
     return 0;
 }
 
-void execute_insn_page(uint8_t *insn_bytes, size_t insn_length, bool set_cond,
+void execute_insn_page(uint8_t *insn_bytes, size_t insn_length, bool thumb,
+                       bool set_cond, uintptr_t reg_init, bool spill_regs,
                        execution_result *exec_result)
 {
-    // Jumps to the instruction buffer
-    void (*exec_page)() = (void(*)()) insn_page;
+    /*
+     * Jumps to the instruction buffer (see emit_boilerplate). The lowest
+     * bit of the address switches to Thumb state on the call.
+     */
+    void (*exec_page)(uintptr_t, uintptr_t, struct USER_REGS_TYPE*,
+                      uint64_t*) =
+        (void(*)(uintptr_t, uintptr_t, struct USER_REGS_TYPE*, uint64_t*))
+        (insn_page + (thumb ? 1 : 0));
 
-    if (set_cond) {
-        uint8_t flags = cond_code_to_flags((insn_bytes[3] >> 4) & 0xf);
-        /*
-         * Reset and update the imm12 field of the msr instruction to include
-         * the new flag bits. A bit nasty, but it works^tm. The 0x200 is for
-         * rotation and part of the imm field encoding.
-         */
-        ((uint32_t*)insn_page)[insn_offset-1] &= ~0xfff;
-        ((uint32_t*)insn_page)[insn_offset-1] |= (0x200 | flags);
-    }
+    uintptr_t flags = 0;
+    if (set_cond)
+        flags = (uintptr_t)cond_code_to_flags((insn_bytes[3] >> 4) & 0xf) << 28;
+
+    // Update the instruction slot in the instruction buffer
+    memcpy(insn_page + insn_offset, insn_bytes, insn_length);
 
-    // Update the first instruction in the instruction buffer
-    memcpy(insn_page + insn_offset * 4, insn_bytes, insn_length);
+    /*
+     * A 16-bit thumb instruction only fills half of the slot, so follow
+     * it with a nop (see fill_insn_buffer)
+     */
+    if (thumb && insn_length == 2) {
+        uint8_t *slot = (uint8_t*)insn_page + insn_offset;
+        slot[2] = 0x00;
+        slot[3] = 0xbf;
+    }
 
     last_insn_signum = 0;
+    last_insn_si_code = 0;
+    last_insn_si_addr = 0;
+    last_insn_syscall = 0;
 
     /*
-     * Clear insn_page (at the insn to be tested + the msr insn before)
-     * in the d- and icache
+     * Clear insn_page (at the insn to be tested) in the d- and icache
      * (some instructions might be skipped otherwise.)
      */
-    __clear_cache(insn_page + (insn_offset-1) * 4,
-                  insn_page + insn_offset * 4 + insn_length);
+    __clear_cache(insn_page + insn_offset, insn_page + insn_offset + 4);
 
-    executing_insn = 1;
+    ++exec_generation;
+    watchdog_expired = 0;
 
-    // Jump to the instruction to be tested (and execute it)
-    exec_page();
+    /*
+     * Jump to the instruction to be tested (and execute it), unless the
+     * watchdog unwinds a hanging instruction back to here. The signal mask
+     * isn't saved, as that would add a syscall to every execution. The
+     * watchdog only unwinds once the jump buffer is set.
+     */
+    volatile uint64_t cycles_before = 0;
+    if (sigsetjmp(watchdog_env, 0) == 0) {
+        executing_insn = 1;
+        if (timing_perf_fd != -1)
+            cycles_before = read_cycle_counter(timing_perf_fd);
+        exec_page(reg_init, flags,
+                  spill_regs ? &exec_result->regs_after : NULL,
+                  &exec_result->ticks);
+    }
 
     executing_insn = 0;
 
+    if (timing_perf_fd != -1)
+        exec_result->ticks = read_cycle_counter(timing_perf_fd)
+                             - cycles_before;
+
     exec_result->signal = last_insn_signum;
+    exec_result->timed_out = watchdog_expired;
+    exec_result->sig_code = last_insn_si_code;
+    exec_result->sig_addr = last_insn_si_addr;
+    exec_result->syscall = last_insn_syscall;
+
+    if (spill_regs) {
+        uintptr_t insn_loc = (uintptr_t)insn_page + insn_offset;
+        uintptr_t pc_after = last_insn_signum != 0 ? last_insn_pc
+                                                   : insn_loc + insn_length;
+#ifdef __aarch64__
+        for (uint32_t i = 0; i < UREG_COUNT; ++i)
+            exec_result->regs_before.regs[i] = reg_init;
+        exec_result->regs_before.sp = reg_init;
+        exec_result->regs_before.pc = insn_loc;
+        exec_result->regs_before.pstate = flags;
+        exec_result->regs_after.pc = pc_after;
+#else
+        for (uint32_t i = 0; i < A32_pc; ++i)
+            exec_result->regs_before.uregs[i] = reg_init;
+        exec_result->regs_before.uregs[A32_pc] = insn_loc;
+        exec_result->regs_before.uregs[A32_cpsr] = flags | 0x10
+                                                   | (thumb ? 0x20 : 0);
+        exec_result->regs_after.uregs[A32_pc] = pc_after;
+#endif
+    }
 }
 
 uint8_t cond_code_to_flags(uint8_t cond)
@@ -411,13 +496,10 @@ typedef struct {
  * From
  *  https://blog.yossarian.net/2019/05/18/Basic-disassembly-with-libopcodes
  */
-int disas_sprintf(void *stream, const char *fmt, ...) {
+int disas_vsprintf(void *stream, const char *fmt, va_list arg) {
     stream_state *ss = (stream_state *)stream;
 
     int n;
-    va_list arg;
-    va_start(arg, fmt);
-
     if (!ss->reenter) {
         n = vasprintf(&ss->buffer, fmt, arg);
         ss->reenter = true;
@@ -437,11 +519,34 @@ int disas_sprintf(void *stream, const char *fmt, ...) {
         free(ss->buffer);
         ss->buffer = tmp2;
     }
-    va_end(arg);
 
     return 0;
 }
 
+int disas_sprintf(void *stream, const char *fmt, ...) {
+    va_list arg;
+    va_start(arg, fmt);
+    int ret = disas_vsprintf(stream, fmt, arg);
+    va_end(arg);
+    return ret;
+}
+
+#ifdef DISASM_INIT_STYLED
+/*
+ * Newer libopcodes (binutils 2.39+) print the operands through a styled
+ * callback. The style is irrelevant here.
+ */
+int disas_styled_sprintf(void *stream, enum disassembler_style style,
+                         const char *fmt, ...) {
+    (void)style;
+    va_list arg;
+    va_start(arg, fmt);
+    int ret = disas_vsprintf(stream, fmt, arg);
+    va_end(arg);
+    return ret;
+}
+#endif
+
 /*
  * Fill buf with the the bytes in insn, taking into account
  * that ARM uses little-endian, and that in Thumb (both 16-bit
@@ -474,23 +579,28 @@ size_t fill_insn_buffer(uint8_t *buf, size_t buf_size, uint32_t insn,
     return 4;
 }
 
-int libopcodes_disassemble(uint32_t insn, bool thumb, char *disas_str,
-                           size_t disas_str_size)
+int libopcodes_disassemble(uint32_t insn, bool aarch32, bool thumb,
+                           char *disas_str, size_t disas_str_size)
 {
     stream_state ss = {};
 
     // Set up the disassembler
     disassemble_info disasm_info = {};
-    init_disassemble_info(&disasm_info, &ss, (fprintf_ftype) disas_sprintf);
-
-#ifdef __aarch64__
-    disasm_info.arch = bfd_arch_aarch64;
-    disasm_info.mach = bfd_mach_aarch64;
+#ifdef DISASM_INIT_STYLED
+    init_disassemble_info(&disasm_info, &ss, (fprintf_ftype) disas_sprintf,
+                          (fprintf_styled_ftype) disas_styled_sprintf);
 #else
-    disasm_info.arch = bfd_arch_arm;
-    disasm_info.mach = bfd_mach_arm_8;
+    init_disassemble_info(&disasm_info, &ss, (fprintf_ftype) disas_sprintf);
 #endif
 
+    if (aarch32) {
+        disasm_info.arch = bfd_arch_arm;
+        disasm_info.mach = bfd_mach_arm_8;
+    } else {
+        disasm_info.arch = bfd_arch_aarch64;
+        disasm_info.mach = bfd_mach_aarch64;
+    }
+
     disasm_info.read_memory_func = buffer_read_memory;
     uint8_t insn_bytes[4];
     size_t buf_length = fill_insn_buffer(insn_bytes, sizeof(insn_bytes),
@@ -531,24 +641,103 @@ int libopcodes_disassemble(uint32_t insn, bool thumb, char *disas_str,
 }
 
 #ifdef USE_CAPSTONE
-int capstone_disassemble(uint32_t insn, bool thumb, char *disas_str,
-                         size_t disas_str_size, csh *handle)
+/*
+ * Detail mode (the operand breakdown) is turned off, as only the
+ * mnemonic and operand string are used.
+ */
+int open_capstone(capstone_state *cs, bool aarch32, bool thumb,
+                  bool use_blocks)
+{
+    if (cs_open(aarch32 ? CS_ARCH_ARM : CS_ARCH_ARM64,
+                CS_MODE_ARM + CS_MODE_LITTLE_ENDIAN
+                + (thumb ? CS_MODE_THUMB : 0),
+                &cs->handle) != CS_ERR_OK)
+        return -1;
+
+    if (cs_option(cs->handle, CS_OPT_DETAIL, CS_OPT_OFF) != CS_ERR_OK
+            || cs_option(cs->handle, CS_OPT_SKIPDATA, CS_OPT_OFF) != CS_ERR_OK
+            || (cs->insn = cs_malloc(cs->handle)) == NULL) {
+        cs_close(&cs->handle);
+        return -1;
+    }
+
+    cs->thumb = thumb;
+    cs->use_blocks = use_blocks;
+    cs->block_valid = false;
+    return 0;
+}
+
+void close_capstone(capstone_state *cs)
+{
+    cs_free(cs->insn, 1);
+    cs_close(&cs->handle);
+}
+
+int capstone_disassemble(capstone_state *cs, uint32_t insn, char *disas_str,
+                         size_t disas_str_size)
 {
-    cs_insn *capstone_insn;
     uint8_t insn_bytes[4];
     size_t buf_length = fill_insn_buffer(insn_bytes, sizeof(insn_bytes),
-                                         insn, thumb);
-    size_t capstone_count = cs_disasm(*handle, insn_bytes, buf_length,
-                                      0, 0, &capstone_insn);
-    if (capstone_count > 0) {
+                                         insn, cs->thumb);
+    const uint8_t *code = insn_bytes;
+    uint64_t address = 0;
+    if (cs_disasm_iter(cs->handle, &code, &buf_length, &address, cs->insn)) {
         snprintf(disas_str,
                  disas_str_size,
-                 "%s\t%s", capstone_insn[0].mnemonic, capstone_insn[0].op_str);
-        cs_free(capstone_insn, capstone_count);
-    } else {
-        strcpy(disas_str, "invalid assembly code");
+                 "%s\t%s", cs->insn->mnemonic, cs->insn->op_str);
+        return 1;
+    }
+
+    strcpy(disas_str, "invalid assembly code");
+    return 0;
+}
+
+/*
+ * Returns a bit per encoding of the block of count (up to
+ * CAPSTONE_BLOCK_SIZE) encodings starting at first, set if capstone can
+ * disassemble it. The encodings are one apart, or one half-word apart for
+ * thumb16.
+ */
+uint64_t capstone_classify_block(capstone_state *cs, uint32_t first,
+                                 uint32_t count)
+{
+    uint32_t shift = (cs->thumb && !is_thumb32(first)) ? 16 : 0;
+    uint64_t defined = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t insn_bytes[4];
+        size_t buf_length = fill_insn_buffer(insn_bytes, sizeof(insn_bytes),
+                                             first + (i << shift), cs->thumb);
+        const uint8_t *code = insn_bytes;
+        uint64_t address = 0;
+        if (cs_disasm_iter(cs->handle, &code, &buf_length, &address,
+                           cs->insn))
+            defined |= 1ull << i;
+    }
+    return defined;
+}
+
+/*
+ * Returns whether capstone can disassemble insn. With use_blocks (every
+ * encoding of a block is visited in order), the whole block is classified
+ * on its first encoding and kept for the rest. Otherwise, e.g. with
+ * -o bitrev or a sparse -m, encodings are classified on their own.
+ */
+bool capstone_defined(capstone_state *cs, uint32_t insn)
+{
+    if (!cs->use_blocks)
+        return capstone_classify_block(cs, insn, 1) & 1;
+
+    uint32_t shift = (cs->thumb && !is_thumb32(insn)) ? 16 : 0;
+    uint32_t first = insn & ~((uint32_t)(CAPSTONE_BLOCK_SIZE - 1) << shift);
+
+    if (!cs->block_valid || cs->block_first != first) {
+        cs->block_valid = true;
+        cs->block_first = first;
+        cs->block_defined = capstone_classify_block(cs, first,
+                                                    CAPSTONE_BLOCK_SIZE);
     }
-    return capstone_count;
+
+    return (cs->block_defined >> ((insn - first) >> shift)) & 1;
 }
 #endif
 
@@ -649,7 +838,7 @@ int custom_ptrace_setvfpregs(pid_t pid, struct USER_VFPREGS_TYPE *regs)
 
 void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
                         size_t insn_length, bool thumb, bool random_regs,
-                        bool vector_regs, bool set_cond,
+                        bool vector_regs, bool set_cond, uintptr_t reg_init,
                         execution_result *result)
 {
     int status;
@@ -724,16 +913,16 @@ void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
     for (uint32_t i = 0; i < UREG_COUNT; ++i) {
 #ifdef __aarch64__
         uint64_t rand_val = ((uint64_t)rand() << 32) | rand();
-        regs.regs[i] = random_regs ? rand_val : 0;
+        regs.regs[i] = random_regs ? rand_val : reg_init;
 #else
         uint32_t rand_val = rand();
-        regs.uregs[i] = random_regs ? rand_val : 0;
+        regs.uregs[i] = random_regs ? rand_val : reg_init;
 #endif
     }
 
     *pc_reg = insn_loc;
 #ifdef __aarch64__
-    regs.sp = random_regs ? ((uint64_t)rand() << 32) | rand() : 0;
+    regs.sp = random_regs ? ((uint64_t)rand() << 32) | rand() : reg_init;
     regs.pstate = 0;
     (void)set_cond;
 #else
@@ -775,11 +964,26 @@ void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
     }
 
     int signo = 0;
+    siginfo_t siginfo;
     do {
         // Execute the instruction
+        ++exec_generation;
+        watchdog_expired = 0;
+        watchdog_pid = slave_pid;
+        executing_insn = 1;
+
         ptrace(PTRACE_CONT, slave_pid, NULL, NULL);
         waitpid(slave_pid, &status, 0);
 
+        executing_insn = 0;
+
+        if ((WIFEXITED(status) || WIFSIGNALED(status)) && watchdog_expired) {
+            // The watchdog killed the hanging slave, so replace it
+            result->timed_out = true;
+            *slave_pid_ptr = spawn_slave(thumb);
+            return;
+        }
+
         if (WIFEXITED(status)) {
             // TODO: Refork slave if it died
             result->died = true;
@@ -801,13 +1005,19 @@ void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
             memcpy(&result->vfp_regs_after, &vfp_regs, sizeof(vfp_regs));
         }
 
-        siginfo_t siginfo;
         if (ptrace(PTRACE_GETSIGINFO, slave_pid, NULL, &siginfo) == -1) {
             perror("getsiginfo failed");
         }
 
         signo = siginfo.si_signo;
         result->signal = (signo == SIGTRAP) ? 0 : signo;
+
+        if (signo != SIGTRAP) {
+            result->sig_code = siginfo.si_code;
+            result->sig_addr = (uintptr_t)siginfo.si_addr;
+            if (signo == SIGSYS)
+                result->syscall = siginfo.si_syscall;
+        }
         /*
          * If the terminal window is resized while executing, the slave
          * might raise a SIGWINCH signal before executing the instruction.
@@ -821,6 +1031,8 @@ void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
         // (as opposed to the bkpt)
         if (signo == SIGTRAP) {
             result->signal = signo;
+            result->sig_code = siginfo.si_code;
+            result->sig_addr = (uintptr_t)siginfo.si_addr;
         }
 
         if (thumb) {
@@ -837,126 +1049,920 @@ void execute_insn_slave(pid_t *slave_pid_ptr, uint8_t *insn_bytes,
     }
 }
 
+result_class get_result_class(execution_result *result)
+{
+    if (result->timed_out)
+        return RESULT_TIMEOUT;
+    return result_class_from_signal(result->signal);
+}
+
 /*
- * Returns the next instruction based on the current one, taking
- * the instruction mask and thumb execution into account.
- *
- * The insn and mask are 64-bit to prevent overflow, such that the
- * caller can check whether the instruction is out of bounds.
+ * Records the result of an instruction in the result map and/or RLE map,
+ * if they are enabled (non-NULL).
  */
-uint64_t get_next_instruction(uint64_t insn, uint64_t mask, bool thumb)
+void record_result(result_map *res_map, rle_writer *rle_map, uint32_t insn,
+                   result_class class)
 {
-    if (thumb && !is_thumb32(insn & 0xffffffff)) {
-        /*
-         * Increment upper half, including the "extended" bits
-         * and taking the supplied mask into account
-         */
-        mask &= 0xffffffffffff0000;
-    }
-    return MASKED_INCREMENT(insn, mask);
-}
+    if (res_map != NULL)
+        set_result(res_map, insn, class);
 
-struct option long_options[] = {
-    {"help",            no_argument,        NULL, 'h'},
-    {"start",           required_argument,  NULL, 's'},
-    {"end",             required_argument,  NULL, 'e'},
-    {"no-exec",         no_argument,        NULL, 'n'},
-    {"log-suffix",      required_argument,  NULL, 'l'},
-    {"quiet",           no_argument,        NULL, 'q'},
-    {"discreps",        no_argument,        NULL, 'd'},
-    {"ptrace",          no_argument,        NULL, 'p'},
-    {"exec-all",        no_argument,        NULL, 'x'},
-    {"print-regs",      no_argument,        NULL, 'r'},
-    {"single-exec",     no_argument,        NULL, 'i'},
-    {"filter",          required_argument,  NULL, 'f'},
-    {"mask",            required_argument,  NULL, 'm'},
-    {"thumb",           no_argument,        NULL, 't'},
-    {"random",          no_argument,        NULL, 'z'},
-    {"log-reg-changes", no_argument,        NULL, 'g'},
-    {"vector",          no_argument,        NULL, 'V'},
-    {"cond",            no_argument,        NULL, 'c'}
-};
+    if (rle_map != NULL && rle_append(rle_map, insn, class) == -1)
+        fprintf(stderr, "ERROR: Failed to write to RLE map\n");
+}
 
-void print_help(char *cmd_name)
+/*
+ * Logs a hidden instruction, or queues it for the writer thread with
+ * --async-log, so that the formatting and the file I/O don't stall the
+ * execution. With --summary, it's also added to the behaviour summary.
+ */
+int log_hidden_insn(char *log_path, execution_result *result,
+                    bool write_regs, bool only_reg_changes,
+                    bool include_vector_regs)
 {
-    printf("Usage: %s [option(s)]\n", cmd_name);
-    printf("\n\
-General options:\n\
-    -h, --help              Print help information.\n\
-    -q, --quiet             Don't print the status line.\n\
-\n\
-Search options:\n\
-    -s, --start <insn>      Start of instruction search range (in hex).\n\
-                            [default: 0x00000000]\n\
-    -e, --end <insn>        End of instruction search range, inclusive (in\n\
-                            hex). [default: 0xffffffff]\n\
-    -i, --single-exec       Execute a single instruction (i.e., set end=start).\n\
-    -m, --mask <mask>       Only update instruction bits marked in the supplied\n\
-                            mask. Useful for testing different operands on a\n\
-                            single instruction. Example: 0xf0000000 -> only\n\
-                            increment most significant nibble.\n\
-\n\
-Execution options:\n\
-    -n, --no-exec           Calculate the total amount of undefined\n\
-                            instructions, without executing them.\n\
-    -x, --exec-all          Execute all instructions (regardless of the\n\
-                            disassembly result).\n\
-    -f, --filter <level>    Filter away (skip) certain instructions that would\n\
-                            otherwise be executed and might generate false\n\
-                            positives. Supports the following levels, where\n\
-                            each level includes the numerically lower ones:\n\
-                                1: Inaccurate disassemblies, primarily caused\n\
-                                   by SBO/SBZ bits.\n\
-                                2: Hidden instructions induced by Linux\n\
-                                   as a result of bugs or backwards\n\
-                                   compatibility measures.\n\
-    -p, --ptrace            Execute instructions on a separate process using\n\
-                            ptrace. This will generally make execution slower,\n\
-                            but lowers the chance of the fuzzer crashing in\n\
-                            case hidden instructions with certain side-effects\n\
-                            are found. It also enables some additional options.\n\
-    -c, --cond              On AArch32: Set the condition flags in the CPSR to\n\
-                            match the condition code in the instruction\n\
-                            encoding. This ensures that undefined instructions\n\
-                            with a normally non-matching condition code won't\n\
-                            be skipped, as is the case in some ISA\n\
-                            implementations.\n\
-\n\
-Logging options:\n\
-    -l, --log-suffix        Add a suffix to the log and status file.\n\
-    -d, --discreps          Log disassembler discrepancies.\n\
-\n\
-Ptrace options (only available with -p option):\n\
-    -t, --thumb             Use the thumb instruction set (only available on\n\
-                            AArch32). Note: 16-bit thumb instructions have the\n\
-                            format XXXX0000. So to test e.g. instruction 46c0,\n\
-                            use 46c00000.\n\
-    -r, --print-regs        Print register values before/after instruction\n\
-                            execution.\n\
-    -z, --random            Load the registers with random values, instead of\n\
-                            all 0s. Note that the random values are generated\n\
-                            at startup, and remain constant throughout the\n\
-                            session.\n\
-    -g, --log-reg-changes   For hidden instructions, only log registers that\n\
-                            changed value.\n\
-    -V, --vector            Set and log vector registers (d0-d31, fpscr) when\n\
-                            fuzzing.\n"
-    );
+    if (hit_sum != NULL)
+        add_hit(hit_sum, result, write_regs, write_regs && include_vector_regs);
+    if (summary_only)
+        return 0;
+
+    if (async_log != NULL) {
+        async_log_result(async_log, result, write_regs, only_reg_changes,
+                         include_vector_regs);
+        return 0;
+    }
+    return write_logfile(log_path, result, write_regs, only_reg_changes,
+                         include_vector_regs);
 }
 
-int main(int argc, char **argv)
+/*
+ * Sets up the chosen execution method: spawns the ptrace slave, or installs
+ * the signal handlers and maps the instruction page.
+ */
+int init_exec_backend(exec_config *config)
 {
-    sig_stack_array = malloc(SIGSTKSZ);
-    sig_stack.ss_size = SIGSTKSZ;
-    sig_stack.ss_sp = sig_stack_array;
+    static scratch_arena sandbox;
 
-    uint32_t insn_range_start = INSN_RANGE_MIN;
-    uint32_t insn_range_end = INSN_RANGE_MAX;
-    uint64_t insn_mask = ~0;
-    bool no_exec = false;
-    bool quiet = false;
-    bool log_discreps = false;
-    bool use_ptrace = false;
+    if (config->use_sandbox) {
+        // Created before the slave is forked, so that it shares the arena
+        if (init_scratch_arena(&sandbox) == -1) {
+            perror("Unable to map the scratch arena");
+            return -1;
+        }
+        config->sandbox = &sandbox;
+    }
+
+    if (config->timeout_ms > 0 && init_watchdog(config->timeout_ms) == -1) {
+        perror("Unable to start the watchdog timer");
+        return -1;
+    }
+
+    if (config->use_ptrace) {
+        config->slave_pid = spawn_slave(config->thumb);
+        return 0;
+    }
+
+    /*
+     * NOTE: It is possible that other signals than these get thrown by
+     * executed instructions, but that hasn't happened in practice
+     * when testing. Add more signals here if that actually happens.
+     */
+    init_signal_handler(signal_handler, SIGILL);
+    init_signal_handler(signal_handler, SIGSEGV);
+    init_signal_handler(signal_handler, SIGBUS);
+    init_signal_handler(signal_handler, SIGTRAP);
+
+    boilerplate_config boilerplate = {
+        .thumb = config->thumb,
+        .spill_regs = config->page_regs,
+        .timing = config->timing && !config->timing_perf,
+    };
+    if (init_insn_page(&boilerplate) != 0) {
+        perror("insn_page mmap failed");
+        return -1;
+    }
+
+    if (config->timing && config->timing_perf) {
+        timing_perf_fd = open_cycle_counter();
+        if (timing_perf_fd == -1) {
+            perror("Unable to open the perf cycle counter");
+            return -1;
+        }
+    }
+
+    if (config->use_seccomp) {
+        init_signal_handler(signal_handler, SIGSYS);
+        if (install_syscall_trap(insn_page, PAGE_SIZE) == -1) {
+            perror("Unable to install the seccomp filter");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Whether the registers after execution are known, i.e. can be logged and
+ * compared.
+ */
+bool captures_regs(exec_config *config)
+{
+    return config->use_ptrace || config->page_regs;
+}
+
+/*
+ * Executes a single instruction, either using a ptrace slave or page
+ * execution within the fuzzer process.
+ */
+void execute_insn(exec_config *config, uint32_t insn, execution_result *result)
+{
+    uint8_t insn_bytes[4];
+    size_t buf_length = fill_insn_buffer(insn_bytes, sizeof(insn_bytes),
+                                         insn, config->thumb);
+
+    if (config->thumb && !is_thumb32(insn)) {
+        insn_bytes[2] = 0;
+        insn_bytes[3] = 0;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->insn = insn;
+
+    uintptr_t reg_init = 0;
+    if (config->sandbox != NULL) {
+        reg_init = config->sandbox->base;
+        result->sandbox_base = reg_init;
+    }
+
+    if (config->use_ptrace) {
+        if (config->random_regs) {
+            /*
+             * Reseed with the same seed to keep the values from changing
+             * between iterations, as changing values makes comparing
+             * side-effects across instructions a lot harder.
+             */
+            srand(config->seed);
+        }
+        execute_insn_slave(&config->slave_pid, insn_bytes, buf_length,
+                           config->thumb, config->random_regs,
+                           config->vector_regs, config->set_cond, reg_init,
+                           result);
+    } else {
+        execute_insn_page(insn_bytes, buf_length, config->thumb,
+                          config->set_cond, reg_init, config->page_regs,
+                          result);
+    }
+
+    // Instructions raising SIGILL can't have touched the arena
+    if (config->sandbox != NULL && result->signal != SIGILL)
+        find_arena_changes(config->sandbox, result);
+}
+
+/*
+ * Runs the fuzzer as the remote executor of --diff-exec: executes batches
+ * of instructions read from stdin, with the settings of the local fuzzer,
+ * and writes the results to stdout.
+ */
+int run_exec_server(void)
+{
+    remote_config config;
+    if (read_remote_config(STDIN_FILENO, &config) != 1) {
+        fprintf(stderr, "ERROR: Invalid remote executor config\n");
+        return 1;
+    }
+
+    exec_config exec = {
+        .aarch32 = NATIVE_AARCH32,
+        .use_ptrace = config.flags & REMOTE_FLAG_PTRACE,
+        .thumb = config.flags & REMOTE_FLAG_THUMB,
+        .random_regs = config.flags & REMOTE_FLAG_RANDOM_REGS,
+        .vector_regs = config.flags & REMOTE_FLAG_VECTOR_REGS,
+        .set_cond = config.flags & REMOTE_FLAG_SET_COND,
+        .seed = config.seed,
+        .timeout_ms = config.timeout_ms,
+        .use_sandbox = config.flags & REMOTE_FLAG_SANDBOX,
+        .use_seccomp = config.flags & REMOTE_FLAG_SECCOMP,
+        .page_regs = config.flags & REMOTE_FLAG_PAGE_REGS,
+    };
+
+    bool compact = config.flags & REMOTE_FLAG_COMPACT;
+    uint32_t expected_size = compact ? sizeof(remote_result)
+                                     : sizeof(execution_result);
+    uint32_t requested_size = config.result_size;
+
+    // Report our own result size, so the fuzzer can detect mismatches
+    config.result_size = expected_size;
+    if (write_remote_config(STDOUT_FILENO, &config) == -1)
+        return 1;
+
+    if (requested_size != expected_size || init_exec_backend(&exec) == -1)
+        return 1;
+
+    static uint32_t insns[REMOTE_BATCH_SIZE];
+    static execution_result results[REMOTE_BATCH_SIZE];
+    uint32_t count;
+    int ret;
+    while ((ret = read_remote_batch(STDIN_FILENO, insns, &count)) == 1) {
+        for (uint32_t i = 0; i < count; ++i)
+            execute_insn(&exec, insns[i], &results[i]);
+
+        if (write_remote_results(STDOUT_FILENO, results, count,
+                                 compact) == -1)
+            return 1;
+    }
+
+    if (!exec.use_ptrace)
+        munmap(insn_page, PAGE_SIZE);
+    return ret == 0 ? 0 : 1;
+}
+
+/*
+ * Executes a batch of instructions both locally and on the remote
+ * executor, and logs the instructions whose results differ.
+ *
+ * The batch is sent before executing it locally, so that both sides
+ * execute it at the same time.
+ */
+int execute_diff_batch(remote_executor *remote, exec_config *exec,
+                       uint32_t *insns, uint32_t count, char *log_path,
+                       search_status *status, result_map *res_map)
+{
+    static execution_result local_results[REMOTE_BATCH_SIZE];
+    static execution_result remote_results[REMOTE_BATCH_SIZE];
+
+    if (remote_submit_batch(remote, insns, count) == -1) {
+        fprintf(stderr, "ERROR: Unable to send instructions to the remote "
+                        "executor\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        execute_insn(exec, insns[i], &local_results[i]);
+
+        if (local_results[i].died) {
+            fprintf(stderr, "slave died. quitting...\n");
+            return -1;
+        }
+    }
+
+    if (remote_collect_results(remote, remote_results, count) == -1) {
+        fprintf(stderr, "ERROR: The remote executor quit unexpectedly\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        record_result(res_map, NULL, insns[i],
+                      get_result_class(&local_results[i]));
+
+        if (results_diverge(&local_results[i], &remote_results[i],
+                            captures_regs(exec), exec->vector_regs)) {
+            if (write_divergence(log_path, &local_results[i],
+                                 &remote_results[i], captures_regs(exec),
+                                 exec->vector_regs) == -1) {
+                fprintf(stderr, "ERROR: Failed to write to logfile\n");
+            }
+            ++status->hidden_instructions_found;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Executes a batch of A32/T32 instructions on the 32-bit executor of
+ * --compat, and logs the hidden ones. The executor replies with compact
+ * results, so no registers are logged.
+ */
+int execute_compat_batch(remote_executor *remote, uint32_t *insns,
+                         uint32_t count, char *log_path,
+                         search_status *status, result_map *res_map)
+{
+    static execution_result results[REMOTE_BATCH_SIZE];
+
+    if (remote_submit_batch(remote, insns, count) == -1
+            || remote_collect_results(remote, results, count) == -1) {
+        fprintf(stderr, "ERROR: The 32-bit executor quit unexpectedly\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (results[i].died) {
+            fprintf(stderr, "slave died. quitting...\n");
+            return -1;
+        }
+
+        record_result(res_map, NULL, insns[i], get_result_class(&results[i]));
+
+        if (results[i].signal != SIGILL) {
+            if (log_hidden_insn(log_path, &results[i], false, false,
+                                false) == -1) {
+                fprintf(stderr, "ERROR: Failed to write to logfile\n");
+            }
+            ++status->hidden_instructions_found;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The first line of the log records the execution settings, so that the
+ * log can be replayed (--replay) under the same conditions.
+ */
+void write_exec_header(FILE *fp, exec_config *config)
+{
+    fprintf(fp, "# exec:ptrace=%d,thumb=%d,random=%d,vector=%d,cond=%d,"
+                "seed=%lld,sandbox=%d,seccomp=%d,aarch32=%d,page_regs=%d,"
+                "timeout=%u\n",
+            config->use_ptrace, config->thumb, config->random_regs,
+            config->vector_regs, config->set_cond, (long long)config->seed,
+            config->use_sandbox, config->use_seccomp, config->aarch32,
+            config->page_regs, config->timeout_ms);
+}
+
+bool parse_exec_header(const char *line, exec_config *config)
+{
+    int use_ptrace, thumb, random_regs, vector_regs, set_cond;
+    int use_sandbox, use_seccomp, aarch32, page_regs;
+    unsigned timeout_ms;
+    long long seed;
+
+    // Logs from older versions don't have the fields after the seed
+    int ret = sscanf(line, "# exec:ptrace=%d,thumb=%d,random=%d,vector=%d,"
+                           "cond=%d,seed=%lld,sandbox=%d,seccomp=%d,"
+                           "aarch32=%d,page_regs=%d,timeout=%u",
+                     &use_ptrace, &thumb, &random_regs, &vector_regs,
+                     &set_cond, &seed, &use_sandbox, &use_seccomp, &aarch32,
+                     &page_regs, &timeout_ms);
+    if (ret < 6)
+        return false;
+
+    config->use_ptrace = use_ptrace;
+    config->thumb = thumb;
+    config->random_regs = random_regs;
+    config->vector_regs = vector_regs;
+    config->set_cond = set_cond;
+    config->seed = seed;
+    config->use_sandbox = (ret >= 7 && use_sandbox);
+    config->use_seccomp = (ret >= 8 && use_seccomp);
+    config->aarch32 = ret >= 9 ? aarch32 : NATIVE_AARCH32;
+    config->page_regs = (ret >= 10 && page_regs);
+    // Without a recorded timeout, the one on the command line is used
+    if (ret >= 11)
+        config->timeout_ms = timeout_ms;
+    return true;
+}
+
+/*
+ * Re-executes every hidden instruction (and divergence) in a log, and
+ * writes whether each one reproduced, changed signal or disappeared (i.e.
+ * now raises SIGILL) to output_path.
+ *
+ * The execution settings are taken from the log header if there is one,
+ * and from the command line otherwise.
+ */
+int run_replay(char *replay_log_path, char *output_path, exec_config *exec,
+               bool quiet)
+{
+    FILE *in_fp = fopen(replay_log_path, "r");
+    if (in_fp == NULL) {
+        perror("Unable to open log to replay");
+        return 1;
+    }
+
+    char line[4096];
+    bool has_header = false;
+    if (fgets(line, sizeof(line), in_fp) != NULL)
+        has_header = parse_exec_header(line, exec);
+    rewind(in_fp);
+
+    if (!has_header && !quiet) {
+        fprintf(stderr, "WARNING: The log has no header, so the execution "
+                        "options on the command line are used.\n");
+    }
+
+    if (exec->aarch32 != NATIVE_AARCH32) {
+        fprintf(stderr, "ERROR: The log is from %s fuzzing, and has to be "
+                        "replayed by the %d-bit fuzzer.\n",
+                exec->aarch32 ? "A32/T32" : "A64", exec->aarch32 ? 32 : 64);
+        return 1;
+    }
+
+    FILE *out_fp = fopen(output_path, "w");
+    if (out_fp == NULL) {
+        perror("Unable to open replay output");
+        return 1;
+    }
+
+    if (init_exec_backend(exec) == -1)
+        return 1;
+
+    unsigned long long reproduced = 0;
+    unsigned long long changed = 0;
+    unsigned long long disappeared = 0;
+
+    while (fgets(line, sizeof(line), in_fp) != NULL) {
+        uint32_t insn;
+        char kind[16];
+        int logged_signal;
+
+        if (line[0] == '#')
+            continue;
+
+        // Discrepancies and other entries weren't executed in the first place
+        if (sscanf(line, "%" SCNx32 ",%15[^,],%d", &insn, kind,
+                   &logged_signal) != 3
+                || (strcmp(kind, "hidden") != 0
+                    && strcmp(kind, "timeout") != 0
+                    && strcmp(kind, "syscall") != 0
+                    && strcmp(kind, "divergence") != 0))
+            continue;
+
+        execution_result exec_result;
+        execute_insn(exec, insn, &exec_result);
+
+        if (exec_result.died) {
+            fprintf(out_fp, "%08" PRIx32 ",died,%d\n", insn, logged_signal);
+            exec->slave_pid = spawn_slave(exec->thumb);
+            ++changed;
+        } else if (exec_result.timed_out) {
+            fprintf(out_fp, "%08" PRIx32 ",timeout,%d\n", insn, logged_signal);
+            ++changed;
+        } else if (exec_result.signal == SIGILL) {
+            fprintf(out_fp, "%08" PRIx32 ",disappeared,%d\n",
+                    insn, logged_signal);
+            ++disappeared;
+        } else if ((int)exec_result.signal != logged_signal) {
+            fprintf(out_fp, "%08" PRIx32 ",changed,%d-%d\n",
+                    insn, logged_signal, exec_result.signal);
+            ++changed;
+        } else {
+            fprintf(out_fp, "%08" PRIx32 ",reproduced,%d\n",
+                    insn, logged_signal);
+            ++reproduced;
+        }
+    }
+
+    fclose(in_fp);
+    fclose(out_fp);
+
+    if (!exec->use_ptrace)
+        munmap(insn_page, PAGE_SIZE);
+
+    printf("reproduced: %llu, changed: %llu, disappeared: %llu\n",
+           reproduced, changed, disappeared);
+    return 0;
+}
+
+/*
+ * Adds the result of one run to the tally. Register outcomes are compared
+ * by a hash of the register values after execution.
+ */
+void tally_result(repeat_tally *tally, execution_result *result,
+                  bool compare_regs, bool include_vector_regs)
+{
+    // Deaths and timeouts are tallied as signals -1 and -2
+    int32_t signal = result->died ? -1
+                     : result->timed_out ? -2 : (int32_t)result->signal;
+    ++tally->runs;
+
+    uint32_t i;
+    for (i = 0; i < tally->signal_count; ++i) {
+        if (tally->signals[i] == signal)
+            break;
+    }
+    if (i == REPEAT_MAX_OUTCOMES) {
+        ++tally->other_runs;
+        return;
+    }
+    if (i == tally->signal_count) {
+        tally->signals[i] = signal;
+        ++tally->signal_count;
+    }
+    ++tally->signal_runs[i];
+
+    if (!compare_regs)
+        return;
+
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    uint8_t *bytes = (uint8_t*)&result->regs_after;
+    for (size_t j = 0; j < sizeof(result->regs_after); ++j)
+        hash = (hash ^ bytes[j]) * 0x100000001b3;
+    if (include_vector_regs) {
+        bytes = (uint8_t*)&result->vfp_regs_after;
+        for (size_t j = 0; j < sizeof(result->vfp_regs_after); ++j)
+            hash = (hash ^ bytes[j]) * 0x100000001b3;
+    }
+
+    for (i = 0; i < tally->outcome_count; ++i) {
+        if (tally->outcomes[i] == hash)
+            break;
+    }
+    if (i == REPEAT_MAX_OUTCOMES) {
+        ++tally->other_runs;
+        return;
+    }
+    if (i == tally->outcome_count) {
+        tally->outcomes[i] = hash;
+        ++tally->outcome_count;
+    }
+    ++tally->outcome_runs[i];
+}
+
+/*
+ * Sets the CPU affinity of the process executing the instructions, i.e. the
+ * ptrace slave or the fuzzer itself.
+ */
+int pin_executor(exec_config *exec, cpu_set_t *cpus)
+{
+    pid_t pid = exec->use_ptrace ? exec->slave_pid : 0;
+    return sched_setaffinity(pid, sizeof(*cpus), cpus);
+}
+
+/*
+ * Re-executes a batch of hidden instructions runs times each, and logs the
+ * distribution of their results. With rotate_cpus, run r of every
+ * instruction is executed on the (r mod n)-th of the n CPUs in the set, so
+ * that each CPU is only switched to once per batch.
+ */
+void repeat_hits(exec_config *exec, uint32_t *insns, uint32_t count,
+                 uint32_t runs, cpu_set_t *rotate_cpus, char *log_path)
+{
+    static repeat_tally tallies[REPEAT_BATCH_SIZE];
+    memset(tallies, 0, count * sizeof(repeat_tally));
+
+    int cpu_count = rotate_cpus != NULL ? CPU_COUNT(rotate_cpus) : 0;
+    int cpu = -1;
+    cpu_set_t pinned;
+
+    for (uint32_t run = 0; run < runs; ++run) {
+        if (cpu_count > 0) {
+            // Find the next CPU in the set, wrapping around
+            do {
+                cpu = (cpu + 1) % CPU_SETSIZE;
+            } while (!CPU_ISSET(cpu, rotate_cpus));
+
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            if (pin_executor(exec, &pinned) == -1)
+                perror("sched_setaffinity failed");
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            execution_result exec_result;
+            execute_insn(exec, insns[i], &exec_result);
+            tallies[i].insn = insns[i];
+            tally_result(&tallies[i], &exec_result, captures_regs(exec),
+                         exec->vector_regs);
+
+            /*
+             * The new slave inherits the fuzzer's affinity, which is
+             * already that of --cpu, but not the CPU of this run.
+             */
+            if (exec_result.died) {
+                exec->slave_pid = spawn_slave(exec->thumb);
+                if (cpu_count > 0 && pin_executor(exec, &pinned) == -1)
+                    perror("sched_setaffinity failed");
+            }
+        }
+    }
+
+    if (cpu_count > 0 && pin_executor(exec, rotate_cpus) == -1)
+        perror("sched_setaffinity failed");
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (write_repeat_tally(log_path, &tallies[i],
+                               captures_regs(exec)) == -1)
+            fprintf(stderr, "ERROR: Failed to write to logfile\n");
+    }
+}
+
+/*
+ * Measures the latency of a nop, which is subtracted from all the runs of
+ * --timing, so that the boilerplate around the instruction (e.g. the
+ * register reset) doesn't count.
+ */
+uint64_t measure_timing_baseline(exec_config *exec, uint32_t runs)
+{
+#ifdef __aarch64__
+    uint32_t nop = 0xd503201f;
+#else
+    uint32_t nop = exec->thumb ? 0xbf000000 : 0xe320f000;
+#endif
+
+    uint64_t baseline = UINT64_MAX;
+    for (uint32_t i = 0; i < runs; ++i) {
+        execution_result result;
+        execute_insn(exec, nop, &result);
+        if (result.ticks < baseline)
+            baseline = result.ticks;
+    }
+    return baseline;
+}
+
+/*
+ * Collects the latencies of runs executions of an instruction for
+ * --timing, where the first one is the execution the fuzzer already did.
+ */
+void time_insn(exec_config *exec, uint32_t insn, uint64_t first_ticks,
+               uint64_t *samples, uint32_t runs)
+{
+    samples[0] = first_ticks;
+    for (uint32_t i = 1; i < runs; ++i) {
+        execution_result result;
+        execute_insn(exec, insn, &result);
+        samples[i] = result.ticks;
+    }
+}
+
+enum {
+    OPT_EXEC_SERVER = 256,
+    OPT_DIFF_EXEC,
+    OPT_REPLAY,
+    OPT_REPEAT,
+    OPT_ROTATE_CPUS,
+    OPT_CPU,
+    OPT_TIMEOUT,
+    OPT_SANDBOX,
+    OPT_SECCOMP,
+    OPT_PAGE_REGS,
+    OPT_COMPAT,
+    OPT_TIMING,
+    OPT_TIMING_PERF,
+    OPT_PERF_STATS,
+    OPT_ASYNC_LOG,
+    OPT_SUMMARY,
+    OPT_SUMMARY_ONLY,
+    OPT_DISAS_CACHE,
+    OPT_NO_CAPSTONE,
+    OPT_SKIP,
+};
+
+struct option long_options[] = {
+    {"help",            no_argument,        NULL, 'h'},
+    {"start",           required_argument,  NULL, 's'},
+    {"end",             required_argument,  NULL, 'e'},
+    {"no-exec",         no_argument,        NULL, 'n'},
+    {"log-suffix",      required_argument,  NULL, 'l'},
+    {"quiet",           no_argument,        NULL, 'q'},
+    {"discreps",        no_argument,        NULL, 'd'},
+    {"ptrace",          no_argument,        NULL, 'p'},
+    {"exec-all",        no_argument,        NULL, 'x'},
+    {"print-regs",      no_argument,        NULL, 'r'},
+    {"single-exec",     no_argument,        NULL, 'i'},
+    {"filter",          required_argument,  NULL, 'f'},
+    {"mask",            required_argument,  NULL, 'm'},
+    {"thumb",           no_argument,        NULL, 't'},
+    {"random",          no_argument,        NULL, 'z'},
+    {"log-reg-changes", no_argument,        NULL, 'g'},
+    {"vector",          no_argument,        NULL, 'V'},
+    {"cond",            no_argument,        NULL, 'c'},
+    {"order",           required_argument,  NULL, 'o'},
+    {"result-map",      required_argument,  NULL, 'M'},
+    {"rle-map",         no_argument,        NULL, 'R'},
+    {"diff-exec",       required_argument,  NULL, OPT_DIFF_EXEC},
+    {"exec-server",     no_argument,        NULL, OPT_EXEC_SERVER},
+    {"replay",          required_argument,  NULL, OPT_REPLAY},
+    {"repeat",          required_argument,  NULL, OPT_REPEAT},
+    {"rotate-cpus",     no_argument,        NULL, OPT_ROTATE_CPUS},
+    {"cpu",             required_argument,  NULL, OPT_CPU},
+    {"timeout",         required_argument,  NULL, OPT_TIMEOUT},
+    {"sandbox",         no_argument,        NULL, OPT_SANDBOX},
+    {"seccomp",         no_argument,        NULL, OPT_SECCOMP},
+    {"page-regs",       no_argument,        NULL, OPT_PAGE_REGS},
+    {"compat",          required_argument,  NULL, OPT_COMPAT},
+    {"timing",          required_argument,  NULL, OPT_TIMING},
+    {"timing-perf",     no_argument,        NULL, OPT_TIMING_PERF},
+    {"perf-stats",      no_argument,        NULL, OPT_PERF_STATS},
+    {"async-log",       no_argument,        NULL, OPT_ASYNC_LOG},
+    {"summary",         no_argument,        NULL, OPT_SUMMARY},
+    {"summary-only",    no_argument,        NULL, OPT_SUMMARY_ONLY},
+    {"disas-cache",     no_argument,        NULL, OPT_DISAS_CACHE},
+    {"no-capstone",     no_argument,        NULL, OPT_NO_CAPSTONE},
+    {"skip",            required_argument,  NULL, OPT_SKIP},
+    {NULL,              0,                  NULL, 0}
+};
+
+void print_help(char *cmd_name)
+{
+    printf("Usage: %s [option(s)]\n", cmd_name);
+    printf("\n\
+General options:\n\
+    -h, --help              Print help information.\n\
+    -q, --quiet             Don't print the status line.\n\
+\n\
+Search options:\n\
+    -s, --start <insn>      Start of instruction search range (in hex).\n\
+                            [default: 0x00000000]\n\
+    -e, --end <insn>        End of instruction search range, inclusive (in\n\
+                            hex). [default: 0xffffffff]\n\
+    -i, --single-exec       Execute a single instruction (i.e., set end=start).\n\
+    -m, --mask <mask>       Only update instruction bits marked in the supplied\n\
+                            mask. Useful for testing different operands on a\n\
+                            single instruction. Example: 0xf0000000 -> only\n\
+                            increment most significant nibble.\n\
+    -o, --order <order>     Order in which the search range is traversed.\n\
+                            Every instruction is still visited exactly once,\n\
+                            but the non-linear orders spread the early\n\
+                            coverage over the whole range, so that a partial\n\
+                            run gives a representative picture. Supports:\n\
+                                linear: Numeric order. [default]\n\
+                                bitrev: Bit-reversed order, i.e. the most\n\
+                                        significant bits change fastest.\n\
+                                stratified: Interleave the encoding groups\n\
+                                        given by bits 25-31, and walk each\n\
+                                        group in numeric order.\n\
+                                <bits>: Comma-separated list of bit\n\
+                                        positions, fastest-changing first.\n\
+                                        Unlisted bits follow in numeric\n\
+                                        order. Example: 31,30,29,28\n\
+    --skip <count>          Skip the first <count> instructions of the\n\
+                            traversal, e.g. to resume a stopped run (in any\n\
+                            order) from the visited count in its status\n\
+                            file. Requires the same -s, -e, -m, -o and -t as\n\
+                            the stopped run.\n\
+    --disas-cache           On AArch64: Cache the encoding classes\n\
+                            libopcodes finds to be defined, i.e. the decoded\n\
+                            instruction with its register operand fields\n\
+                            free, and skip disassembling the other encodings\n\
+                            of a cached class. Opcodes whose decoding has\n\
+                            extra checks aren't cached. Capstone still runs\n\
+                            on cached encodings with -d only, so without it,\n\
+                            discrepancies aren't counted for them. The hit\n\
+                            rate is printed at the end. Requires the bundled\n\
+                            libopcodes.\n\
+    --no-capstone           Classify the instructions with libopcodes only,\n\
+                            even if the fuzzer is built with capstone. Can't\n\
+                            be combined with -d.\n\
+\n\
+Execution options:\n\
+    -n, --no-exec           Calculate the total amount of undefined\n\
+                            instructions, without executing them.\n\
+    -x, --exec-all          Execute all instructions (regardless of the\n\
+                            disassembly result).\n\
+    -f, --filter <level>    Filter away (skip) certain instructions that would\n\
+                            otherwise be executed and might generate false\n\
+                            positives. Supports the following levels, where\n\
+                            each level includes the numerically lower ones:\n\
+                                1: Inaccurate disassemblies, primarily caused\n\
+                                   by SBO/SBZ bits.\n\
+                                2: Hidden instructions induced by Linux\n\
+                                   as a result of bugs or backwards\n\
+                                   compatibility measures.\n\
+    -p, --ptrace            Execute instructions on a separate process using\n\
+                            ptrace. This will generally make execution slower,\n\
+                            but lowers the chance of the fuzzer crashing in\n\
+                            case hidden instructions with certain side-effects\n\
+                            are found. It also enables some additional options.\n\
+    -c, --cond              On AArch32: Set the condition flags in the CPSR to\n\
+                            match the condition code in the instruction\n\
+                            encoding. This ensures that undefined instructions\n\
+                            with a normally non-matching condition code won't\n\
+                            be skipped, as is the case in some ISA\n\
+                            implementations.\n\
+    -t, --thumb             Use the thumb instruction set (on AArch32, or with\n\
+                            --compat). Note: 16-bit thumb instructions have the\n\
+                            format XXXX0000. So to test e.g. instruction 46c0,\n\
+                            use 46c00000.\n\
+    --timeout <ms>          Abort instructions that haven't finished executing\n\
+                            after between 1x and 2x the given time, and log\n\
+                            them as timeouts. 0 disables the watchdog.\n\
+                            [default: 1000]\n\
+    --sandbox               Point all registers (including sp) at the middle\n\
+                            of a 64 KiB scratch arena surrounded by guard\n\
+                            pages, instead of setting them to 0. For hidden\n\
+                            instructions, the changed byte ranges of the\n\
+                            arena are logged as mem:base<offset>:<length>.\n\
+                            The accessed address of SIGSEGV/SIGBUS is also\n\
+                            logged relative to the arena, as addr:base<offset>.\n\
+    --seccomp               In page execution, install a seccomp filter that\n\
+                            traps every syscall made from the instruction\n\
+                            page. Hidden instructions that behave like svc\n\
+                            are then logged as syscall (with the syscall\n\
+                            number), instead of being executed. This gives\n\
+                            much of the safety of -p without the slowdown.\n\
+    --page-regs             In page execution, store the general purpose\n\
+                            registers after every instruction, and log them\n\
+                            for hidden instructions like -p does (with -g\n\
+                            supported). Vector registers still require -p.\n\
+\n\
+Timing options:\n\
+    --timing <runs>         In page execution, measure the latency of every\n\
+                            executed instruction with the virtual counter\n\
+                            (CNTVCT) read around it, over <runs> runs, and\n\
+                            write its distribution (min, quartiles and max,\n\
+                            in counter ticks, minus the latency of a nop) to\n\
+                            data/timing<suffix>. Instructions that are more\n\
+                            than twice as slow (or fast) as the executed\n\
+                            encodings around them are flagged as slow (or\n\
+                            fast).\n\
+    --timing-perf           With --timing: Measure in CPU cycles with a perf\n\
+                            counter instead, which is finer, but adds two\n\
+                            syscalls to every run. Used automatically if the\n\
+                            counter frequency isn't set.\n\
+    --perf-stats            Count the cycles, instructions, context\n\
+                            switches, page faults and L1I misses of the\n\
+                            fuzzer (not of the -p slave), and the time spent\n\
+                            disassembling and executing, and write them per\n\
+                            region of 0x1000 encodings (i.e. per status\n\
+                            update) to data/perf<suffix>. Counters that\n\
+                            aren't available (e.g. hardware counters under\n\
+                            QEMU) are logged as \"-\".\n\
+\n\
+Differential execution options:\n\
+    --diff-exec <cmd>       Execute every instruction both locally and on a\n\
+                            second executor started with <cmd> (with\n\
+                            --exec-server appended), e.g. \"qemu-aarch64\n\
+                            ./fuzzer\". Only instructions with different\n\
+                            results (signal, and registers with -p) are\n\
+                            logged, as divergences. The execution options\n\
+                            are forwarded to the second executor.\n\
+    --exec-server           Run as the second executor of --diff-exec,\n\
+                            reading instructions from stdin. Not meant to be\n\
+                            used directly.\n\
+\n\
+Compat options:\n\
+    --compat <cmd>          On AArch64: Fuzz A32 (or T32 with -t) by executing\n\
+                            the instructions on a 32-bit executor started\n\
+                            with <cmd> (with --exec-server appended), e.g.\n\
+                            ./fuzzer32 (see make fuzzer32). Disassembly,\n\
+                            filtering and logging stay in this process. The\n\
+                            execution options are forwarded to the executor,\n\
+                            but registers aren't logged.\n\
+\n\
+Nondeterminism options:\n\
+    --repeat <n>            Re-execute every hidden instruction n more times,\n\
+                            and log the distribution of signals (and of\n\
+                            register outcomes with -p) as a repeat entry,\n\
+                            marked deterministic or nondeterministic. The\n\
+                            hidden instructions are re-executed in batches.\n\
+    --rotate-cpus           With --repeat: Spread the runs over all the CPUs\n\
+                            the fuzzer is allowed to run on, by pinning the\n\
+                            executing process with sched_setaffinity.\n\
+\n\
+CPU options:\n\
+    --cpu <n>               Pin the fuzzer (and the ptrace slave) to CPU n,\n\
+                            and record the CPU and its MIDR in the log. On\n\
+                            heterogeneous (big.LITTLE) systems, this ties\n\
+                            the results to a single microarchitecture.\n\
+\n\
+Replay options:\n\
+    --replay <log>          Re-execute every hidden instruction in a log (e.g.\n\
+                            data/log0), with the execution options recorded\n\
+                            in the log, and write whether each one\n\
+                            reproduced, changed signal or disappeared to\n\
+                            data/replay<suffix>. The search options are\n\
+                            ignored.\n\
+\n\
+Logging options:\n\
+    -l, --log-suffix        Add a suffix to the log and status file.\n\
+    -d, --discreps          Log disassembler discrepancies.\n\
+    -M, --result-map <file> Record the result class (skipped, filtered,\n\
+                            SIGILL, no signal, ...) of every visited\n\
+                            instruction in a memory-mapped result map. The\n\
+                            map covers the whole instruction space, so\n\
+                            several workers can share the same file. Use\n\
+                            tools/mapdiff to compare two maps.\n\
+    -R, --rle-map           Record the result class of every visited\n\
+                            instruction in a run-length encoded map, stored\n\
+                            in data/rlemap<suffix>. Only supported with the\n\
+                            linear order. Use tools/rletool to merge the\n\
+                            per-worker maps and compare maps.\n\
+    --async-log             Format and write the log of hidden instructions\n\
+                            in a separate thread, so that the execution\n\
+                            doesn't wait for the disk. The lines that are\n\
+                            still queued are lost if the fuzzer crashes.\n\
+    --summary               Group the hidden instructions by behaviour\n\
+                            (signal, changed registers, pc delta and the\n\
+                            kind of values written), and write the groups\n\
+                            of encodings with the same behaviour as\n\
+                            <value>/<mask>,<count> to data/summary<suffix>.\n\
+    --summary-only          Like --summary, but don't log the hidden\n\
+                            instructions individually.\n\
+\n\
+Ptrace options (only available with -p option):\n\
+    -r, --print-regs        Print register values before/after instruction\n\
+                            execution.\n\
+    -z, --random            Load the registers with random values, instead of\n\
+                            all 0s. Note that the random values are generated\n\
+                            at startup, and remain constant throughout the\n\
+                            session.\n\
+    -g, --log-reg-changes   For hidden instructions, only log registers that\n\
+                            changed value.\n\
+    -V, --vector            Set and log vector registers (d0-d31, fpscr) when\n\
+                            fuzzing.\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    sig_stack_array = malloc(SIGSTKSZ);
+    sig_stack.ss_size = SIGSTKSZ;
+    sig_stack.ss_sp = sig_stack_array;
+
+    uint32_t insn_range_start = INSN_RANGE_MIN;
+    uint32_t insn_range_end = INSN_RANGE_MAX;
+    uint64_t insn_mask = ~0;
+    bool no_exec = false;
+    bool quiet = false;
+    bool log_discreps = false;
+    bool use_ptrace = false;
     bool exec_all = false;
     bool print_regs = false;
     bool single_insn = false;
@@ -966,13 +1972,34 @@ int main(int argc, char **argv)
     bool only_reg_changes = false;
     bool include_vector_regs = false;
     bool set_cond = false;
+    insn_order order = { .type = ORDER_LINEAR };
+    uint64_t skip_count = 0;
     time_t start_time = time(NULL);
 
     char *file_suffix = NULL;
+    char *result_map_path = NULL;
+    bool use_rle_map = false;
+    char *diff_exec_cmd = NULL;
+    char *replay_log_path = NULL;
+    uint32_t repeat_runs = 0;
+    bool rotate_cpus = false;
+    int pin_cpu = -1;
+    uint32_t timeout_ms = DEFAULT_TIMEOUT_MS;
+    bool use_sandbox = false;
+    bool use_seccomp = false;
+    bool page_regs = false;
+    char *compat_cmd = NULL;
+    uint32_t timing_runs = 0;
+    bool timing_perf = false;
+    bool use_perf_stats = false;
+    bool use_async_log = false;
+    bool use_summary = false;
+    bool use_disas_cache = false;
+    bool use_capstone = true;
     char *endptr;
     uint64_t opt_temp;
     int c;
-    while ((c = getopt_long(argc, argv, "hs:e:nl:qdpxrif:m:tzgVc",
+    while ((c = getopt_long(argc, argv, "hs:e:nl:qdpxrif:m:tzgVco:M:R",
                             long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
@@ -1080,13 +2107,7 @@ int main(int argc, char **argv)
                 insn_mask = 0xffffffff00000000 | (insn_mask & 0xffffffff);
                 break;
             case 't':
-#ifdef __aarch64__
-                fprintf(stderr, "Thumb execution is only available on "
-                                "AArch32.\n");
-                return 1;
-#else
                 thumb = true;
-#endif
                 break;
             case 'z':
                 random_regs = true;
@@ -1103,6 +2124,118 @@ int main(int argc, char **argv)
                 return 1;
 #else
                 set_cond = true;
+#endif
+                break;
+            case 'o':
+                if (parse_insn_order(optarg, &order) == -1) {
+                    fprintf(stderr, "ERROR: Invalid traversal order \"%s\"\n",
+                            optarg);
+                    return 1;
+                }
+                break;
+            case 'M':
+                result_map_path = optarg;
+                break;
+            case 'R':
+                use_rle_map = true;
+                break;
+            case OPT_DIFF_EXEC:
+                diff_exec_cmd = optarg;
+                break;
+            case OPT_EXEC_SERVER:
+                return run_exec_server();
+            case OPT_REPLAY:
+                replay_log_path = optarg;
+                break;
+            case OPT_REPEAT:
+                opt_temp = strtoull(optarg, &endptr, 10);
+
+                if (*endptr != '\0' || opt_temp < 1 || opt_temp > 0xffff) {
+                    fprintf(stderr, "ERROR: Repeat count must be between 1 "
+                                    "and 65535.\n");
+                    return 1;
+                }
+                repeat_runs = (uint32_t)opt_temp;
+                break;
+            case OPT_ROTATE_CPUS:
+                rotate_cpus = true;
+                break;
+            case OPT_CPU:
+                opt_temp = strtoull(optarg, &endptr, 10);
+
+                if (*endptr != '\0' || opt_temp >= CPU_SETSIZE) {
+                    fprintf(stderr, "ERROR: Invalid CPU number\n");
+                    return 1;
+                }
+                pin_cpu = (int)opt_temp;
+                break;
+            case OPT_TIMEOUT:
+                opt_temp = strtoull(optarg, &endptr, 10);
+
+                if (*endptr != '\0' || opt_temp > 3600000) {
+                    fprintf(stderr, "ERROR: Invalid timeout\n");
+                    return 1;
+                }
+                timeout_ms = (uint32_t)opt_temp;
+                break;
+            case OPT_SANDBOX:
+                use_sandbox = true;
+                break;
+            case OPT_SECCOMP:
+                use_seccomp = true;
+                break;
+            case OPT_PAGE_REGS:
+                page_regs = true;
+                break;
+            case OPT_TIMING:
+                opt_temp = strtoull(optarg, &endptr, 10);
+
+                if (*endptr != '\0' || opt_temp < 1
+                        || opt_temp > TIMING_MAX_RUNS) {
+                    fprintf(stderr, "ERROR: Timing runs must be between 1 "
+                                    "and %d.\n", TIMING_MAX_RUNS);
+                    return 1;
+                }
+                timing_runs = (uint32_t)opt_temp;
+                break;
+            case OPT_TIMING_PERF:
+                timing_perf = true;
+                break;
+            case OPT_PERF_STATS:
+                use_perf_stats = true;
+                break;
+            case OPT_ASYNC_LOG:
+                use_async_log = true;
+                break;
+            case OPT_SUMMARY:
+                use_summary = true;
+                break;
+            case OPT_SUMMARY_ONLY:
+                use_summary = true;
+                summary_only = true;
+                break;
+            case OPT_DISAS_CACHE:
+                use_disas_cache = true;
+                break;
+            case OPT_NO_CAPSTONE:
+                use_capstone = false;
+                break;
+            case OPT_SKIP:
+                opt_temp = strtoull(optarg, &endptr, 10);
+
+                if (*endptr != '\0' || optarg[0] == '-') {
+                    fprintf(stderr, "ERROR: Failed to parse skip count\n");
+                    return 1;
+                }
+                skip_count = opt_temp;
+                break;
+            case OPT_COMPAT:
+#ifdef __aarch64__
+                compat_cmd = optarg;
+#else
+                fprintf(stderr, "--compat is only available on AArch64, as "
+                                "A32/T32 is executed natively here.\n");
+                return 1;
 #endif
                 break;
             default:
@@ -1111,31 +2244,132 @@ int main(int argc, char **argv)
         }
     }
 
-    if (thumb && !use_ptrace) {
-        /*
-         * Only ptrace execution supported for thumb as of now, as page exec
-         * requires quite a few changes with little to be gained, seeing
-         * as the thumb(2) instruction space is an order of magnitude smaller
-         * than A32.
-         */
-        fprintf(stderr, "Thumb execution requires ptrace. "
-                        "Run with -p option.\n");
+    bool aarch32 = NATIVE_AARCH32 || compat_cmd != NULL;
+
+    if (thumb && !aarch32) {
+        fprintf(stderr, "Thumb execution on AArch64 requires a 32-bit "
+                        "executor. Run with --compat.\n");
+        return 1;
+    }
+
+    if (compat_cmd != NULL && (diff_exec_cmd != NULL || repeat_runs > 0
+                               || replay_log_path != NULL || use_rle_map)) {
+        fprintf(stderr, "--compat can't be used with --diff-exec, --repeat, "
+                        "--replay or -R.\n");
+        return 1;
+    }
+
+    if (use_disas_cache && aarch32) {
+        fprintf(stderr, "--disas-cache only supports A64.\n");
+        return 1;
+    }
+
+    if (!use_capstone && log_discreps) {
+        fprintf(stderr, "--no-capstone can't be combined with -d.\n");
+        return 1;
+    }
+
+    if (use_disas_cache && !disas_cache_supported()) {
+        fprintf(stderr, "--disas-cache requires the bundled libopcodes, "
+                        "not SHARED_LIBOPCODES.\n");
+        return 1;
+    }
+
+    if (compat_cmd != NULL && (print_regs || only_reg_changes
+                               || include_vector_regs || page_regs)) {
+        fprintf(stderr, "--compat doesn't support -r, -g, -V or --page-regs, "
+                        "as the registers are in the format of the 32-bit "
+                        "executor.\n");
         return 1;
     }
 
-    if ((print_regs || random_regs || only_reg_changes || include_vector_regs)
+    if ((print_regs || random_regs || include_vector_regs
+                || (only_reg_changes && !page_regs))
             && !use_ptrace) {
         fprintf(stderr, "One or more of the supplied options require ptrace "
                         "execution. Run with -p option.\n");
         return 1;
     }
 
+    if (use_rle_map && order.type != ORDER_LINEAR) {
+        fprintf(stderr, "The RLE map requires the linear order. Use -M "
+                        "instead, and convert it with tools/rletool.\n");
+        return 1;
+    }
+
+    if (use_rle_map && diff_exec_cmd != NULL) {
+        fprintf(stderr, "The RLE map can't be used with --diff-exec. Use -M "
+                        "instead.\n");
+        return 1;
+    }
+
+    if (rotate_cpus && repeat_runs == 0) {
+        fprintf(stderr, "--rotate-cpus requires --repeat.\n");
+        return 1;
+    }
+
+    if (repeat_runs > 0 && diff_exec_cmd != NULL) {
+        fprintf(stderr, "--repeat can't be used with --diff-exec.\n");
+        return 1;
+    }
+
+    if (use_sandbox && random_regs) {
+        fprintf(stderr, "--sandbox can't be used with -z, as the registers "
+                        "are pointed into the scratch arena.\n");
+        return 1;
+    }
+
+    if (use_seccomp && use_ptrace) {
+        fprintf(stderr, "--seccomp only applies to page execution, and can't "
+                        "be used with -p.\n");
+        return 1;
+    }
+
+    if (page_regs && use_ptrace) {
+        fprintf(stderr, "--page-regs only applies to page execution, as -p "
+                        "captures the registers already.\n");
+        return 1;
+    }
+
+    if (timing_runs > 0 && (use_ptrace || diff_exec_cmd != NULL
+                            || compat_cmd != NULL)) {
+        fprintf(stderr, "--timing only applies to page execution, and can't "
+                        "be used with -p, --diff-exec or --compat.\n");
+        return 1;
+    }
+
+    if (timing_perf && timing_runs == 0) {
+        fprintf(stderr, "--timing-perf requires --timing.\n");
+        return 1;
+    }
+
+    if (timing_runs > 0 && !timing_perf && read_counter_frequency() == 0) {
+        fprintf(stderr, "WARNING: The counter frequency isn't set, so the "
+                        "perf cycle counter is used for --timing.\n");
+        timing_perf = true;
+    }
+
+    if (rotate_cpus && pin_cpu != -1) {
+        fprintf(stderr, "--rotate-cpus can't be used with --cpu.\n");
+        return 1;
+    }
+
     if (single_insn)
         insn_range_end = insn_range_start;
 
-    pid_t slave_pid = 0;
-    if (use_ptrace)
-        slave_pid = spawn_slave(thumb);
+    if (pin_cpu != -1) {
+        /*
+         * Pin before the slave is spawned, so that it inherits the
+         * affinity, and no migration can mix results from different cores.
+         */
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(pin_cpu, &pinned);
+        if (sched_setaffinity(0, sizeof(pinned), &pinned) == -1) {
+            perror("Unable to pin the fuzzer to the given CPU");
+            return 1;
+        }
+    }
 
     char *log_path;
     if (asprintf(&log_path, "%s%s", "data/log",
@@ -1151,6 +2385,41 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    char *rle_map_path;
+    if (asprintf(&rle_map_path, "%s%s", "data/rlemap",
+                 file_suffix == NULL ? "" : file_suffix) == -1) {
+        fprintf(stderr, "ERROR: asprintf with rle_map_path failed\n");
+        return 1;
+    }
+
+    char *replay_path;
+    if (asprintf(&replay_path, "%s%s", "data/replay",
+                 file_suffix == NULL ? "" : file_suffix) == -1) {
+        fprintf(stderr, "ERROR: asprintf with replay_path failed\n");
+        return 1;
+    }
+
+    char *timing_path;
+    if (asprintf(&timing_path, "%s%s", "data/timing",
+                 file_suffix == NULL ? "" : file_suffix) == -1) {
+        fprintf(stderr, "ERROR: asprintf with timing_path failed\n");
+        return 1;
+    }
+
+    char *perf_stats_path;
+    if (asprintf(&perf_stats_path, "%s%s", "data/perf",
+                 file_suffix == NULL ? "" : file_suffix) == -1) {
+        fprintf(stderr, "ERROR: asprintf with perf_stats_path failed\n");
+        return 1;
+    }
+
+    char *summary_path;
+    if (asprintf(&summary_path, "%s%s", "data/summary",
+                 file_suffix == NULL ? "" : file_suffix) == -1) {
+        fprintf(stderr, "ERROR: asprintf with summary_path failed\n");
+        return 1;
+    }
+
     if (file_suffix != NULL)
         free(file_suffix);
 
@@ -1160,33 +2429,50 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    insn_iterator insn_it;
+    init_insn_iterator(&insn_it, &order, insn_range_start, insn_range_end,
+                       insn_mask, thumb);
+    if (skip_insns(&insn_it, skip_count) < skip_count) {
+        fprintf(stderr, "ERROR: The skip count is larger than the number of "
+                        "instructions in the range\n");
+        return 1;
+    }
+    // Whole blocks are only worth filtering if all of each is visited
+    bool filter_dense =
+        insn_iterator_is_dense(&insn_it, __builtin_ctz(FILTER_BLOCK_SIZE));
 
 #ifdef USE_CAPSTONE
-	csh cs_handle;
-
-	if (cs_open(CAPSTONE_ARCH,
-            CS_MODE_ARM + CS_MODE_LITTLE_ENDIAN + (thumb ? CS_MODE_THUMB : 0),
-            &cs_handle) != CS_ERR_OK) {
+    /*
+     * Whole blocks are classified when all of each is visited. With
+     * --disas-cache (and without -d), capstone is skipped for cached
+     * encodings, which whole blocks would classify anyway.
+     */
+    capstone_state cs;
+    bool capstone_blocks =
+        (!use_disas_cache || log_discreps)
+        && insn_iterator_is_dense(&insn_it,
+                                  __builtin_ctz(CAPSTONE_BLOCK_SIZE));
+    if (open_capstone(&cs, aarch32, thumb, capstone_blocks) == -1) {
         fprintf(stderr, "ERROR: Unable to load capstone\n");
-		return 1;
+        return 1;
     }
 #endif
 
-    if (!use_ptrace) {
-        /*
-         * NOTE: It is possible that other signals than these get thrown by
-         * executed instructions, but that hasn't happened in practice
-         * when testing. Add more signals here if that actually happens.
-         */
-        init_signal_handler(signal_handler, SIGILL);
-        init_signal_handler(signal_handler, SIGSEGV);
-        init_signal_handler(signal_handler, SIGTRAP);
-
-        if (init_insn_page() != 0) {
-            perror("insn_page mmap failed");
-            return 1;
-        }
-    }
+    exec_config exec = {
+        .aarch32 = aarch32,
+        .use_ptrace = use_ptrace,
+        .thumb = thumb,
+        .random_regs = random_regs,
+        .vector_regs = include_vector_regs,
+        .set_cond = set_cond,
+        .seed = start_time,
+        .timeout_ms = timeout_ms,
+        .use_sandbox = use_sandbox,
+        .use_seccomp = use_seccomp,
+        .page_regs = page_regs,
+        .timing = timing_runs > 0,
+        .timing_perf = timing_perf,
+    };
 
     struct stat st = {0};
 
@@ -1198,59 +2484,249 @@ int main(int argc, char **argv)
         }
     }
 
-    // Clear/create log file
-    FILE *log_fp = fopen(log_path, "w");
+    if (replay_log_path != NULL)
+        return run_replay(replay_log_path, replay_path, &exec, quiet);
+
+    /*
+     * Started before the execution backend, so that the executor doesn't
+     * inherit the seccomp filter.
+     */
+    char *remote_cmd = diff_exec_cmd != NULL ? diff_exec_cmd : compat_cmd;
+    remote_executor remote;
+    static uint32_t remote_batch[REMOTE_BATCH_SIZE];
+    uint32_t remote_batch_count = 0;
+    // Set if the remote executor failed, so that the run exits with an error
+    bool remote_failed = false;
+    if (remote_cmd != NULL) {
+        remote_config config = {
+            .flags = (use_ptrace ? REMOTE_FLAG_PTRACE : 0)
+                     | (thumb ? REMOTE_FLAG_THUMB : 0)
+                     | (random_regs ? REMOTE_FLAG_RANDOM_REGS : 0)
+                     | (include_vector_regs ? REMOTE_FLAG_VECTOR_REGS : 0)
+                     | (set_cond ? REMOTE_FLAG_SET_COND : 0)
+                     | (use_sandbox ? REMOTE_FLAG_SANDBOX : 0)
+                     | (use_seccomp ? REMOTE_FLAG_SECCOMP : 0)
+                     | (page_regs ? REMOTE_FLAG_PAGE_REGS : 0)
+                     | (compat_cmd != NULL ? REMOTE_FLAG_COMPACT : 0),
+            .seed = start_time,
+            .timeout_ms = timeout_ms,
+        };
+
+        // A dead executor is reported by remote_submit_batch instead
+        signal(SIGPIPE, SIG_IGN);
+
+        if (spawn_remote_executor(&remote, remote_cmd, &config) == -1) {
+            fprintf(stderr, "ERROR: Unable to start the remote executor "
+                            "(%s)\n", remote_cmd);
+            return 1;
+        }
+    }
+
+    // With --compat, nothing is executed locally
+    if (compat_cmd == NULL && init_exec_backend(&exec) == -1)
+        return 1;
+
+    cpu_set_t allowed_cpus;
+    if (rotate_cpus
+            && sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) == -1) {
+        perror("sched_getaffinity failed");
+        return 1;
+    }
+
+    static uint32_t repeat_batch[REPEAT_BATCH_SIZE];
+    uint32_t repeat_batch_count = 0;
+
+    /*
+     * A resumed run (--skip) appends to the log of the stopped one. The
+     * other outputs are rewritten as a whole, so rather than losing the
+     * stopped run's data, resuming with the same suffix is refused.
+     */
+    if (skip_count > 0) {
+        const char *outputs[] = {
+            use_rle_map ? rle_map_path : NULL,
+            timing_runs > 0 ? timing_path : NULL,
+            use_perf_stats ? perf_stats_path : NULL,
+            use_summary ? summary_path : NULL,
+        };
+        for (uint32_t i = 0; i < sizeof(outputs) / sizeof(*outputs); ++i) {
+            if (outputs[i] != NULL && stat(outputs[i], &st) == 0) {
+                fprintf(stderr, "ERROR: %s already exists. Resume with a "
+                                "new -l suffix.\n", outputs[i]);
+                return 1;
+            }
+        }
+    }
+
+    uint32_t isa = !aarch32 ? RESULT_MAP_ISA_A64
+                   : thumb ? RESULT_MAP_ISA_T32 : RESULT_MAP_ISA_A32;
+
+    result_map res_map;
+    result_map *res_map_ptr = NULL;
+    if (result_map_path != NULL) {
+        if (open_result_map(&res_map, result_map_path, isa,
+                            insn_range_start, insn_range_end) == -1) {
+            perror("Unable to open result map");
+            return 1;
+        }
+        res_map_ptr = &res_map;
+    }
+
+    rle_writer rle_map;
+    rle_writer *rle_map_ptr = NULL;
+    if (use_rle_map) {
+        if (open_rle_writer(&rle_map, rle_map_path, isa) == -1) {
+            perror("Unable to open RLE map");
+            return 1;
+        }
+        rle_map_ptr = &rle_map;
+    }
+
+    timing_log timing;
+    static uint64_t timing_samples[TIMING_MAX_RUNS];
+    if (timing_runs > 0) {
+        uint64_t baseline = measure_timing_baseline(&exec, timing_runs);
+        if (open_timing_log(&timing, timing_path,
+                            timing_perf ? "perf" : "cntvct",
+                            timing_perf ? 0 : read_counter_frequency(),
+                            timing_runs, baseline) == -1) {
+            perror("Unable to open timing log");
+            return 1;
+        }
+    }
+
+    perf_stats perf;
+    perf_stats *perf_ptr = NULL;
+    if (use_perf_stats) {
+        if (open_perf_stats(&perf, perf_stats_path) == -1) {
+            perror("Unable to open perf stats log");
+            return 1;
+        }
+        perf_ptr = &perf;
+    }
+
+    // Clear/create log file, or keep the hits of the run being resumed
+    FILE *log_fp = fopen(log_path, skip_count > 0 ? "a" : "w");
     if (log_fp == NULL) {
         fprintf(stderr,
                 "Error opening logfile (%s). Logging will be disabled.\n",
                 log_path);
     } else {
+        // The header has to be the first line, for --replay
+        if (ftell(log_fp) == 0) {
+            write_exec_header(log_fp, &exec);
+            if (pin_cpu != -1)
+                fprintf(log_fp, "# cpu:%d,midr:%08llx\n", pin_cpu,
+                        (unsigned long long)read_midr(pin_cpu));
+        }
         fclose(log_fp);
     }
 
+    static hit_summary summary;
+    if (use_summary) {
+        init_hit_summary(&summary);
+        hit_sum = &summary;
+    }
+
+    static disas_cache dcache;
+    disas_cache *dcache_ptr = NULL;
+    if (use_disas_cache) {
+        init_disas_cache(&dcache);
+        dcache_ptr = &dcache;
+    }
+
+    // Started after the slave is forked, which must not copy a thread
+    static async_logger logger;
+    if (use_async_log) {
+        if (start_async_logger(&logger, log_path) == -1) {
+            perror("Unable to start the log writer thread");
+            return 1;
+        }
+        async_log = &logger;
+    }
+
     uint64_t last_timestamp = get_nano_timestamp();
 
     search_status curr_status = {0};
     curr_status.insn = insn_range_start & 0xffffffff;
 
-    for (uint64_t i = insn_range_start;
-            i <= insn_range_end;
-            i = get_next_instruction(i, insn_mask, thumb)) {
-        curr_status.insn = i & 0xffffffff;
+    uint32_t region_first = curr_status.insn;
+    uint64_t disas_start = 0;
+
+    uint32_t insn;
+    uint64_t next_visited = skip_count;
+    while (next_insn(&insn_it, &insn)) {
+        uint32_t prev_insn = curr_status.insn;
+        curr_status.insn = insn;
+        curr_status.visited = next_visited++;
+
+        uint64_t total_insns = (curr_status.instructions_checked
+                                + curr_status.instructions_skipped
+                                + curr_status.instructions_filtered);
+        bool status_update = (total_insns % STATUS_UPDATE_RATE == 0
+                              || curr_status.insn == insn_range_end);
+
+        if (perf_ptr != NULL)
+            disas_start = get_nano_timestamp();
+
+        // Status updates always disassemble, for the statusline
+        bool cached = dcache_ptr != NULL && !status_update
+                      && lookup_disas_cache(dcache_ptr, curr_status.insn);
 
 #ifdef USE_CAPSTONE
         // Check if capstone thinks the instruction is undefined
-        int capstone_ret = capstone_disassemble(curr_status.insn,
-                                                thumb,
-                                                curr_status.cs_disas,
-                                                sizeof(curr_status.cs_disas),
-                                                &cs_handle);
+        // The disassembly itself is only needed for the status and for
+        // discrepancies
+        bool capstone_undefined = false;
+        if (!use_capstone) {
+            strncpy(curr_status.cs_disas, "N/A",
+                    sizeof(curr_status.cs_disas));
+            capstone_undefined = true;
+        } else {
+            if (!cached || log_discreps)
+                capstone_undefined = !capstone_defined(&cs, curr_status.insn);
+            if (status_update)
+                capstone_disassemble(&cs, curr_status.insn,
+                                     curr_status.cs_disas,
+                                     sizeof(curr_status.cs_disas));
+        }
 
-        bool capstone_undefined = (capstone_ret == 0);
+        // A discrepancy is logged with the libopcodes disassembly
+        bool libopcodes_needed = !cached
+                                 || (log_discreps && capstone_undefined);
 #else
         strncpy(curr_status.cs_disas, "N/A", sizeof(curr_status.cs_disas));
         bool capstone_undefined = true;
+        bool libopcodes_needed = !cached;
 #endif
 
         // Now check what libopcodes thinks
-        int libopcodes_ret = libopcodes_disassemble(curr_status.insn,
-                                        thumb,
-                                        curr_status.libopcodes_disas,
-                                        sizeof(curr_status.libopcodes_disas));
-        if (libopcodes_ret == 0) {
-            fprintf(stderr, "libopcodes disassembly failed on "
-                            "insn 0x%08" PRIx32 "\n",
-                    curr_status.insn);
-            return 1;
+        bool libopcodes_undefined = false;
+        if (libopcodes_needed) {
+            int libopcodes_ret = libopcodes_disassemble(curr_status.insn,
+                                    aarch32, thumb,
+                                    curr_status.libopcodes_disas,
+                                    sizeof(curr_status.libopcodes_disas));
+            if (libopcodes_ret == 0) {
+                fprintf(stderr, "libopcodes disassembly failed on "
+                                "insn 0x%08" PRIx32 "\n",
+                        curr_status.insn);
+                return 1;
+            }
+
+            libopcodes_undefined =
+                    (strstr(curr_status.libopcodes_disas, "undefined") != NULL
+                  || strstr(curr_status.libopcodes_disas, "NYI") != NULL
+                  || strstr(curr_status.libopcodes_disas, "UNDEFINED") != NULL);
+
+            if (dcache_ptr != NULL && !cached && !libopcodes_undefined)
+                add_disas_cache(dcache_ptr, curr_status.insn);
         }
 
-        uint64_t total_insns = (curr_status.instructions_checked
-                                + curr_status.instructions_skipped
-                                + curr_status.instructions_filtered);
+        if (perf_ptr != NULL)
+            perf_ptr->disas_ns += get_nano_timestamp() - disas_start;
 
         // Write the current search status to the statusfile now and then
-        if (total_insns % STATUS_UPDATE_RATE == 0
-                || curr_status.insn == insn_range_end) {
+        if (status_update) {
             uint64_t curr_timestamp = get_nano_timestamp();
             curr_status.instructions_per_sec = STATUS_UPDATE_RATE /
                 (double)((curr_timestamp - last_timestamp) / 1e9);
@@ -1260,15 +2736,26 @@ int main(int argc, char **argv)
                 fprintf(stderr, "ERROR: Failed to write to statusfile\n");
             }
 
+            // Let the completed runs survive a crash
+            if (rle_map_ptr != NULL)
+                flush_rle_writer(rle_map_ptr);
+
+            if (hit_sum != NULL && hit_sum->dirty
+                    && write_hit_summary(hit_sum, summary_path) == -1)
+                fprintf(stderr, "ERROR: Failed to write summary\n");
+
+            // The current instruction starts the next region
+            if (perf_ptr != NULL) {
+                if (write_perf_region(perf_ptr, region_first, prev_insn,
+                                      &curr_status) == -1)
+                    fprintf(stderr, "ERROR: Failed to write perf stats\n");
+                region_first = curr_status.insn;
+            }
+
             if (!quiet)
                 print_statusline(&curr_status);
         }
 
-        bool libopcodes_undefined =
-                (strstr(curr_status.libopcodes_disas, "undefined") != NULL
-              || strstr(curr_status.libopcodes_disas, "NYI") != NULL
-              || strstr(curr_status.libopcodes_disas, "UNDEFINED") != NULL);
-
         /* Only test instructions that both capstone and libopcodes think are
          * undefined, but report inconsistencies, as they might indicate
          * bugs in either of the disassemblers.
@@ -1287,8 +2774,11 @@ int main(int argc, char **argv)
              * Don't write anything if we're only using libopcodes though.
              */
 #ifdef USE_CAPSTONE
-            if (capstone_undefined || libopcodes_undefined) {
+            if (use_capstone && (capstone_undefined || libopcodes_undefined)) {
                 if (log_discreps) {
+                        capstone_disassemble(&cs, curr_status.insn,
+                                             curr_status.cs_disas,
+                                             sizeof(curr_status.cs_disas));
                         log_fp = fopen(log_path, "a");
 
                         if (log_fp != NULL) {
@@ -1303,79 +2793,151 @@ int main(int argc, char **argv)
             }
 #else
             (void)log_discreps;
+            (void)use_capstone;
 #endif
 
+            record_result(res_map_ptr, rle_map_ptr, curr_status.insn,
+                          RESULT_SKIPPED);
             ++curr_status.instructions_skipped;
             continue;
         } else if (no_exec) {
             // Just count the undefined instruction and continue if we're not
             // going to execute it anyway (because of the no_exec flag)
+            record_result(res_map_ptr, rle_map_ptr, curr_status.insn,
+                          RESULT_UNEXECUTED);
             ++curr_status.instructions_checked;
             continue;
         }
 
-        if (filter_instruction(curr_status.insn, thumb, filter_level)
+        if (filter_instruction(curr_status.insn, aarch32, thumb, filter_level,
+                               filter_dense)
                 && !exec_all) {
+            record_result(res_map_ptr, rle_map_ptr, curr_status.insn,
+                          RESULT_FILTERED);
             ++curr_status.instructions_filtered;
             continue;
         }
 
-        uint8_t insn_bytes[4];
-        size_t buf_length = fill_insn_buffer(insn_bytes,
-                                             sizeof(insn_bytes),
-                                             curr_status.insn,
-                                             thumb);
-
-        if (thumb && !is_thumb32(curr_status.insn)) {
-            insn_bytes[2] = 0;
-            insn_bytes[3] = 0;
+        if (remote_cmd != NULL) {
+            /*
+             * Batch the instructions, to amortise the round trip to the
+             * remote executor (which is slow when it runs under QEMU).
+             */
+            remote_batch[remote_batch_count++] = curr_status.insn;
+            if (remote_batch_count == REMOTE_BATCH_SIZE) {
+                uint64_t exec_start = perf_ptr != NULL
+                                      ? get_nano_timestamp() : 0;
+                int ret = compat_cmd != NULL
+                    ? execute_compat_batch(&remote, remote_batch,
+                                           remote_batch_count, log_path,
+                                           &curr_status, res_map_ptr)
+                    : execute_diff_batch(&remote, &exec, remote_batch,
+                                         remote_batch_count, log_path,
+                                         &curr_status, res_map_ptr);
+                if (perf_ptr != NULL)
+                    perf_ptr->exec_ns += get_nano_timestamp() - exec_start;
+                remote_batch_count = 0;
+                if (ret == -1) {
+                    remote_failed = true;
+                    break;
+                }
+            }
+            ++curr_status.instructions_checked;
+            continue;
         }
 
-        execution_result exec_result = {0};
-        exec_result.insn = curr_status.insn;
+        // Finally, execute the generated instruction
+        execution_result exec_result;
+        uint64_t exec_start = perf_ptr != NULL ? get_nano_timestamp() : 0;
+        execute_insn(&exec, curr_status.insn, &exec_result);
+        if (perf_ptr != NULL)
+            perf_ptr->exec_ns += get_nano_timestamp() - exec_start;
 
-        /*
-         * Finally, execute the generated instruction, either using a ptrace
-         * slave or page execution within the fuzzer process.
-         */
         if (use_ptrace) {
-            if (random_regs) {
-                /*
-                 * Reseed with the same seed to keep the values from changing
-                 * between iterations, as changing values makes comparing
-                 * side-effects across instructions a lot harder.
-                 */
-                srand(start_time);
-            }
-            execute_insn_slave(&slave_pid, insn_bytes, buf_length,
-                               thumb, random_regs, include_vector_regs,
-                               set_cond, &exec_result);
-
             if (exec_result.died) {
                 fprintf(stderr, "slave died. quitting...\n");
                 break;
             }
 
-            last_insn_signum = exec_result.signal;
             if (print_regs)
                 print_execution_result(&exec_result, include_vector_regs);
-        } else {
-            assert(!thumb);
+        }
 
-            execute_insn_page(insn_bytes, buf_length, set_cond, &exec_result);
+        record_result(res_map_ptr, rle_map_ptr, curr_status.insn,
+                      get_result_class(&exec_result));
+
+        if (timing_runs > 0) {
+            time_insn(&exec, curr_status.insn, exec_result.ticks,
+                      timing_samples, timing_runs);
+            if (add_timing(&timing, curr_status.insn, timing_samples,
+                           timing_runs) == -1) {
+                fprintf(stderr, "ERROR: Failed to write to timing log\n");
+            }
         }
 
-        if (last_insn_signum != SIGILL) {
-            if (write_logfile(log_path, &exec_result, use_ptrace,
-                              only_reg_changes, include_vector_regs) == -1) {
+        if (exec_result.signal != SIGILL) {
+            if (log_hidden_insn(log_path, &exec_result, captures_regs(&exec),
+                                only_reg_changes, include_vector_regs) == -1) {
                 fprintf(stderr, "ERROR: Failed to write to logfile\n");
             }
             ++curr_status.hidden_instructions_found;
+
+            if (repeat_runs > 0) {
+                repeat_batch[repeat_batch_count++] = curr_status.insn;
+                if (repeat_batch_count == REPEAT_BATCH_SIZE) {
+                    repeat_hits(&exec, repeat_batch, repeat_batch_count,
+                                repeat_runs,
+                                rotate_cpus ? &allowed_cpus : NULL, log_path);
+                    repeat_batch_count = 0;
+                }
+            }
         }
 
         ++curr_status.instructions_checked;
     }
 
+    if (repeat_batch_count > 0)
+        repeat_hits(&exec, repeat_batch, repeat_batch_count, repeat_runs,
+                    rotate_cpus ? &allowed_cpus : NULL, log_path);
+
+    if (compat_cmd != NULL) {
+        if (remote_batch_count > 0
+                && execute_compat_batch(&remote, remote_batch,
+                                        remote_batch_count, log_path,
+                                        &curr_status, res_map_ptr) == -1)
+            remote_failed = true;
+        stop_remote_executor(&remote);
+    } else if (diff_exec_cmd != NULL) {
+        if (remote_batch_count > 0
+                && execute_diff_batch(&remote, &exec, remote_batch,
+                                      remote_batch_count, log_path,
+                                      &curr_status, res_map_ptr) == -1)
+            remote_failed = true;
+        stop_remote_executor(&remote);
+    }
+
+    if (async_log != NULL) {
+        if (stop_async_logger(async_log) == -1)
+            fprintf(stderr, "ERROR: Failed to write to logfile\n");
+        async_log = NULL;
+    }
+
+    if (hit_sum != NULL) {
+        if (write_hit_summary(hit_sum, summary_path) == -1)
+            fprintf(stderr, "ERROR: Failed to write summary\n");
+        free_hit_summary(hit_sum);
+        hit_sum = NULL;
+    }
+    free(summary_path);
+
+    if (perf_ptr != NULL) {
+        if (write_perf_region(perf_ptr, region_first, curr_status.insn,
+                              &curr_status) == -1
+                || close_perf_stats(perf_ptr) == -1)
+            fprintf(stderr, "ERROR: Failed to write perf stats\n");
+    }
+    free(perf_stats_path);
+
     // Print statusline one last time to capture the result of the last insn
     print_statusline(&curr_status);
     write_statusfile(statusfile_path, &curr_status);
@@ -1383,13 +2945,28 @@ int main(int argc, char **argv)
     // Compensate for the statusline not having a linebreak
     printf("\n");
 
-    if (!use_ptrace)
+    if (dcache_ptr != NULL)
+        print_disas_cache_stats(dcache_ptr, stdout);
+
+    if (!use_ptrace && compat_cmd == NULL)
         munmap(insn_page, PAGE_SIZE);
 
+    if (res_map_ptr != NULL)
+        close_result_map(res_map_ptr);
+
+    if (rle_map_ptr != NULL && close_rle_writer(rle_map_ptr) == -1)
+        fprintf(stderr, "ERROR: Failed to write RLE map\n");
+    free(rle_map_path);
+    free(replay_path);
+
+    if (timing_runs > 0 && close_timing_log(&timing) == -1)
+        fprintf(stderr, "ERROR: Failed to write timing log\n");
+    free(timing_path);
+
 #ifdef USE_CAPSTONE
-    cs_close(&cs_handle);
+    close_capstone(&cs);
 #endif
     free(log_path);
 
-    return 0;
+    return remote_failed ? 1 : 0;
 }
@@ -1,9 +1,11 @@
+#define _GNU_SOURCE
 #include "logging.h"
+#include <signal.h>
 #include <stdio.h>
 #include <sys/file.h>
 
 #ifndef __aarch64__
-static const char *REG_STR[] = {
+const char *REG_STR[] = {
     [0] = "r0",
     [1] = "r1",
     [2] = "r2",
@@ -25,6 +27,165 @@ static const char *REG_STR[] = {
 };
 #endif
 
+static const char *ILL_CODE_STR[] = {
+    [ILL_ILLOPC] = "ILL_ILLOPC",
+    [ILL_ILLOPN] = "ILL_ILLOPN",
+    [ILL_ILLADR] = "ILL_ILLADR",
+    [ILL_ILLTRP] = "ILL_ILLTRP",
+    [ILL_PRVOPC] = "ILL_PRVOPC",
+    [ILL_PRVREG] = "ILL_PRVREG",
+    [ILL_COPROC] = "ILL_COPROC",
+    [ILL_BADSTK] = "ILL_BADSTK",
+};
+
+static const char *FPE_CODE_STR[] = {
+    [FPE_INTDIV] = "FPE_INTDIV",
+    [FPE_INTOVF] = "FPE_INTOVF",
+    [FPE_FLTDIV] = "FPE_FLTDIV",
+    [FPE_FLTOVF] = "FPE_FLTOVF",
+    [FPE_FLTUND] = "FPE_FLTUND",
+    [FPE_FLTRES] = "FPE_FLTRES",
+    [FPE_FLTINV] = "FPE_FLTINV",
+    [FPE_FLTSUB] = "FPE_FLTSUB",
+};
+
+static const char *SEGV_CODE_STR[] = {
+    [SEGV_MAPERR] = "SEGV_MAPERR",
+    [SEGV_ACCERR] = "SEGV_ACCERR",
+};
+
+static const char *BUS_CODE_STR[] = {
+    [BUS_ADRALN] = "BUS_ADRALN",
+    [BUS_ADRERR] = "BUS_ADRERR",
+    [BUS_OBJERR] = "BUS_OBJERR",
+};
+
+// Only defined in the kernel headers
+#ifndef SYS_SECCOMP
+#define SYS_SECCOMP 1
+#endif
+
+static const char *SYS_CODE_STR[] = {
+    [SYS_SECCOMP] = "SYS_SECCOMP",
+};
+
+static const char *TRAP_CODE_STR[] = {
+    [TRAP_BRKPT] = "TRAP_BRKPT",
+    [TRAP_TRACE] = "TRAP_TRACE",
+};
+
+#define CODE_STR_ENTRY(table, code) \
+    ((code) > 0 && (size_t)(code) < sizeof(table) / sizeof(*(table)) \
+     ? (table)[code] : NULL)
+
+/*
+ * Returns the name of a signal's si_code, or NULL if it's unknown (in
+ * which case it's logged as a number).
+ */
+static const char *si_code_name(int signal, int code)
+{
+    switch (code) {
+        case SI_USER:
+            return "SI_USER";
+        case SI_KERNEL:
+            return "SI_KERNEL";
+        case SI_QUEUE:
+            return "SI_QUEUE";
+        case SI_TKILL:
+            return "SI_TKILL";
+    }
+
+    switch (signal) {
+        case SIGILL:
+            return CODE_STR_ENTRY(ILL_CODE_STR, code);
+        case SIGFPE:
+            return CODE_STR_ENTRY(FPE_CODE_STR, code);
+        case SIGSEGV:
+            return CODE_STR_ENTRY(SEGV_CODE_STR, code);
+        case SIGBUS:
+            return CODE_STR_ENTRY(BUS_CODE_STR, code);
+        case SIGTRAP:
+            return CODE_STR_ENTRY(TRAP_CODE_STR, code);
+        case SIGSYS:
+            return CODE_STR_ENTRY(SYS_CODE_STR, code);
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * si_addr is only set for faults raised by the kernel, where it's the
+ * address of the instruction, or for SIGSEGV/SIGBUS the accessed address.
+ */
+bool si_addr_is_valid(int signal, int code)
+{
+    if (code <= 0 || code == SI_KERNEL)
+        return false;
+    return signal == SIGILL || signal == SIGFPE || signal == SIGSEGV
+           || signal == SIGBUS || signal == SIGTRAP || signal == SIGSYS;
+}
+
+bool si_addr_is_data(int signal)
+{
+    return signal == SIGSEGV || signal == SIGBUS;
+}
+
+void write_si_code(FILE *fp, int signal, int code)
+{
+    const char *name = si_code_name(signal, code);
+    if (name != NULL)
+        fprintf(fp, "%s", name);
+    else
+        fprintf(fp, "%d", code);
+}
+
+static void write_base_offset(FILE *fp, int64_t offset)
+{
+    fprintf(fp, "base%c0x%llx", offset < 0 ? '-' : '+',
+            (unsigned long long)(offset < 0 ? -offset : offset));
+}
+
+/*
+ * Appends the signal details as code:<si_code> and addr:<si_addr> (the
+ * latter relative to the register base for memory faults with --sandbox).
+ */
+static void write_signal_info(FILE *fp, execution_result *result)
+{
+    if (result->signal == 0 || result->timed_out)
+        return;
+
+    fprintf(fp, ",code:");
+    write_si_code(fp, result->signal, result->sig_code);
+
+    if (result->signal == SIGSYS)
+        fprintf(fp, ",syscall:%" PRId32, result->syscall);
+
+    if (!si_addr_is_valid(result->signal, result->sig_code))
+        return;
+
+    fprintf(fp, ",addr:");
+    if (result->sandbox_base != 0 && si_addr_is_data(result->signal))
+        write_base_offset(fp, result->sig_addr - result->sandbox_base);
+    else
+        fprintf(fp, "%llx", (unsigned long long)result->sig_addr);
+}
+
+/*
+ * Appends the changed ranges of the scratch arena with --sandbox, as
+ * mem:<offset>:<length>, relative to the register base.
+ */
+static void write_memory_effects(FILE *fp, execution_result *result)
+{
+    for (uint32_t i = 0; i < result->mem_change_count; ++i) {
+        fprintf(fp, ",mem:");
+        write_base_offset(fp, result->mem_changes[i].offset);
+        fprintf(fp, ":%" PRIu32, result->mem_changes[i].length);
+    }
+
+    if (result->mem_bytes_dropped > 0)
+        fprintf(fp, ",mem_more:%" PRIu32, result->mem_bytes_dropped);
+}
+
 void print_statusline(search_status *status)
 {
     printf("\rinsn: 0x%08" PRIx32 ", "
@@ -92,6 +253,11 @@ void print_execution_result(execution_result *result, bool include_vector_regs)
     }
 #endif
     printf("signal: %d\n", result->signal);
+    if (result->signal != 0) {
+        printf("si_code: ");
+        write_si_code(stdout, result->signal, result->sig_code);
+        printf("\nsi_addr: %llx\n", (unsigned long long)result->sig_addr);
+    }
 }
 
 int write_statusfile(char *filepath, search_status *status)
@@ -114,7 +280,8 @@ int write_statusfile(char *filepath, search_status *status)
             "instructions_skipped:%" PRIu64 "\n"
             "instructions_filtered:%" PRIu64 "\n"
             "hidden_instructions_found:%" PRIu64 "\n"
-            "instructions_per_sec:%" PRIu64 "\n",
+            "instructions_per_sec:%" PRIu64 "\n"
+            "visited:%" PRIu64 "\n",
             status->insn,
             status->cs_disas,
             status->libopcodes_disas,
@@ -122,7 +289,8 @@ int write_statusfile(char *filepath, search_status *status)
             status->instructions_skipped,
             status->instructions_filtered,
             status->hidden_instructions_found,
-            status->instructions_per_sec
+            status->instructions_per_sec,
+            status->visited
         );
 
     if (flock(fileno(fp), LOCK_UN) == -1) {
@@ -134,17 +302,21 @@ int write_statusfile(char *filepath, search_status *status)
     return 0;
 }
 
-int write_logfile(char *filepath, execution_result *exec_result,
-                  bool write_regs, bool only_reg_changes,
-                  bool include_vector_regs)
+/*
+ * Formats the log line of a hidden instruction to log_fp.
+ */
+void write_log_entry(FILE *log_fp, execution_result *exec_result,
+                     bool write_regs, bool only_reg_changes,
+                     bool include_vector_regs)
 {
-    FILE *log_fp = fopen(filepath, "a");
+    const char *kind = "hidden";
+    if (exec_result->timed_out)
+        kind = "timeout";
+    else if (exec_result->signal == SIGSYS)
+        kind = "syscall";
 
-    if (log_fp == NULL)
-        return -1;
-
-    fprintf(log_fp, "%08" PRIx32 ",hidden,%d",
-            exec_result->insn, exec_result->signal);
+    fprintf(log_fp, "%08" PRIx32 ",%s,%d",
+            exec_result->insn, kind, exec_result->signal);
 
     if (write_regs) {
 #ifdef __aarch64__
@@ -217,22 +389,22 @@ int write_logfile(char *filepath, execution_result *exec_result,
             if (only_reg_changes) {
                 if (exec_result->vfp_regs_before.fpsr
                         != exec_result->vfp_regs_after.fpsr) {
-                    printf(",fpsr:%x-%x",
-                           exec_result->vfp_regs_before.fpsr,
-                           exec_result->vfp_regs_after.fpsr);
+                    fprintf(log_fp, ",fpsr:%x-%x",
+                            exec_result->vfp_regs_before.fpsr,
+                            exec_result->vfp_regs_after.fpsr);
                 }
                 if (exec_result->vfp_regs_before.fpcr
                         != exec_result->vfp_regs_after.fpcr) {
-                    printf(",fpcr:%x-%x",
-                           exec_result->vfp_regs_before.fpcr,
-                           exec_result->vfp_regs_after.fpcr);
+                    fprintf(log_fp, ",fpcr:%x-%x",
+                            exec_result->vfp_regs_before.fpcr,
+                            exec_result->vfp_regs_after.fpcr);
                 }
             } else {
-                printf(",%x-%x,%x-%x",
-                       exec_result->vfp_regs_before.fpsr,
-                       exec_result->vfp_regs_after.fpsr,
-                       exec_result->vfp_regs_before.fpcr,
-                       exec_result->vfp_regs_after.fpcr);
+                fprintf(log_fp, ",%x-%x,%x-%x",
+                        exec_result->vfp_regs_before.fpsr,
+                        exec_result->vfp_regs_after.fpsr,
+                        exec_result->vfp_regs_before.fpcr,
+                        exec_result->vfp_regs_after.fpcr);
             }
         }
 #else
@@ -280,9 +452,160 @@ int write_logfile(char *filepath, execution_result *exec_result,
                         exec_result->vfp_regs_after.fpscr);
             }
         }
+#endif
+    }
+    write_signal_info(log_fp, exec_result);
+    write_memory_effects(log_fp, exec_result);
+    fprintf(log_fp, "\n");
+}
+
+int write_logfile(char *filepath, execution_result *exec_result,
+                  bool write_regs, bool only_reg_changes,
+                  bool include_vector_regs)
+{
+    FILE *log_fp = fopen(filepath, "a");
+
+    if (log_fp == NULL)
+        return -1;
+
+    write_log_entry(log_fp, exec_result, write_regs, only_reg_changes,
+                    include_vector_regs);
+    fclose(log_fp);
+    return 0;
+}
+
+/*
+ * Logs an instruction that behaved differently on the local and the remote
+ * executor, as <insn>,divergence,<local signal>,<remote signal>, followed
+ * by the registers whose values differ after execution, as
+ * <reg>:<local value>-<remote value>. The pc is logged as the offset from
+ * the instruction.
+ */
+int write_divergence(char *filepath, execution_result *local,
+                     execution_result *remote, bool write_regs,
+                     bool include_vector_regs)
+{
+    FILE *log_fp = fopen(filepath, "a");
+
+    if (log_fp == NULL)
+        return -1;
+
+    fprintf(log_fp, "%08" PRIx32 ",divergence,%d,%d",
+            local->insn, local->signal, remote->signal);
+
+    if (local->signal == remote->signal && local->signal != 0
+            && local->sig_code != remote->sig_code) {
+        fprintf(log_fp, ",code:");
+        write_si_code(log_fp, local->signal, local->sig_code);
+        fprintf(log_fp, "-");
+        write_si_code(log_fp, remote->signal, remote->sig_code);
+    }
+
+    if (write_regs) {
+#ifdef __aarch64__
+        for (uint32_t i = 0; i < UREG_COUNT; ++i) {
+            if (local->regs_after.regs[i] != remote->regs_after.regs[i])
+                fprintf(log_fp, ",x%" PRIu32 ":%llx-%llx", i,
+                        local->regs_after.regs[i], remote->regs_after.regs[i]);
+        }
+
+        unsigned long long local_pc = local->regs_after.pc
+                                      - local->regs_before.pc;
+        unsigned long long remote_pc = remote->regs_after.pc
+                                       - remote->regs_before.pc;
+        if (local->regs_after.sp != remote->regs_after.sp)
+            fprintf(log_fp, ",sp:%llx-%llx",
+                    local->regs_after.sp, remote->regs_after.sp);
+        if (local_pc != remote_pc)
+            fprintf(log_fp, ",pc:%llx-%llx", local_pc, remote_pc);
+        if (local->regs_after.pstate != remote->regs_after.pstate)
+            fprintf(log_fp, ",pstate:%llx-%llx",
+                    local->regs_after.pstate, remote->regs_after.pstate);
+
+        if (include_vector_regs) {
+            for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+                __uint128_t a = local->vfp_regs_after.vregs[i];
+                __uint128_t b = remote->vfp_regs_after.vregs[i];
+                if (a != b)
+                    fprintf(log_fp, ",v%" PRIu32 ":%016" PRIx64 "%016" PRIx64
+                            "-%016" PRIx64 "%016" PRIx64, i,
+                            (uint64_t)(a >> 64), (uint64_t)a,
+                            (uint64_t)(b >> 64), (uint64_t)b);
+            }
+            if (local->vfp_regs_after.fpsr != remote->vfp_regs_after.fpsr)
+                fprintf(log_fp, ",fpsr:%x-%x", local->vfp_regs_after.fpsr,
+                        remote->vfp_regs_after.fpsr);
+            if (local->vfp_regs_after.fpcr != remote->vfp_regs_after.fpcr)
+                fprintf(log_fp, ",fpcr:%x-%x", local->vfp_regs_after.fpcr,
+                        remote->vfp_regs_after.fpcr);
+        }
+#else
+        for (uint32_t i = 0; i < UREG_COUNT; ++i) {
+            unsigned long a = local->regs_after.uregs[i];
+            unsigned long b = remote->regs_after.uregs[i];
+            if (i == A32_ORIG_r0)
+                continue;
+            if (i == A32_pc) {
+                a -= local->regs_before.uregs[i];
+                b -= remote->regs_before.uregs[i];
+            }
+            if (a != b)
+                fprintf(log_fp, ",%s:%lx-%lx", REG_STR[i], a, b);
+        }
+
+        if (include_vector_regs) {
+            for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+                if (local->vfp_regs_after.fpregs[i]
+                        != remote->vfp_regs_after.fpregs[i])
+                    fprintf(log_fp, ",d%" PRIu32 ":%llx-%llx", i,
+                            local->vfp_regs_after.fpregs[i],
+                            remote->vfp_regs_after.fpregs[i]);
+            }
+            if (local->vfp_regs_after.fpscr != remote->vfp_regs_after.fpscr)
+                fprintf(log_fp, ",fpscr:%lx-%lx", local->vfp_regs_after.fpscr,
+                        remote->vfp_regs_after.fpscr);
+        }
 #endif
     }
     fprintf(log_fp, "\n");
     fclose(log_fp);
     return 0;
 }
+
+/*
+ * Logs the distribution of results of an instruction executed several
+ * times (--repeat), as <insn>,repeat,<runs>,signals:<signal>=<runs>/...,
+ * followed by the number of runs of each distinct register outcome (if
+ * registers are logged), and whether the results were deterministic.
+ */
+int write_repeat_tally(char *filepath, repeat_tally *tally, bool write_regs)
+{
+    FILE *log_fp = fopen(filepath, "a");
+
+    if (log_fp == NULL)
+        return -1;
+
+    fprintf(log_fp, "%08" PRIx32 ",repeat,%" PRIu32 ",signals:",
+            tally->insn, tally->runs);
+    for (uint32_t i = 0; i < tally->signal_count; ++i)
+        fprintf(log_fp, "%s%d=%" PRIu32, i == 0 ? "" : "/",
+                tally->signals[i], tally->signal_runs[i]);
+
+    if (write_regs) {
+        fprintf(log_fp, ",reg_outcomes:");
+        for (uint32_t i = 0; i < tally->outcome_count; ++i)
+            fprintf(log_fp, "%s%" PRIu32, i == 0 ? "" : "/",
+                    tally->outcome_runs[i]);
+    }
+
+    if (tally->other_runs > 0)
+        fprintf(log_fp, ",other:%" PRIu32, tally->other_runs);
+
+    bool deterministic = (tally->signal_count == 1
+                          && tally->outcome_count <= 1
+                          && tally->other_runs == 0);
+    fprintf(log_fp, ",%s\n", deterministic ? "deterministic"
+                                           : "nondeterministic");
+    fclose(log_fp);
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include "order.h"
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+// Increment bits in x indicated by the mask m
+#define MASKED_INCREMENT(x, m) ((x & ~m) | (((x | ~m) + 1) & m))
+
+/*
+ * The bits used to stratify the search space. Bits 25-31 cover the
+ * top-level encoding groups of all three instruction sets (op0 in A64,
+ * cond and op0 in A32 and the 16/32-bit prefix in T32).
+ */
+#define STRATA_LOW_BIT 25
+
+/*
+ * Parses an order given on the command line. Valid orders are "linear",
+ * "bitrev", "stratified" or a comma-separated list of bit positions
+ * (fastest-changing first).
+ *
+ * Returns 0 on success and -1 if the order is invalid.
+ */
+int parse_insn_order(const char *str, insn_order *order)
+{
+    memset(order, 0, sizeof(*order));
+
+    if (strcmp(str, "linear") == 0) {
+        order->type = ORDER_LINEAR;
+        return 0;
+    } else if (strcmp(str, "bitrev") == 0) {
+        order->type = ORDER_BITREV;
+        return 0;
+    } else if (strcmp(str, "stratified") == 0) {
+        order->type = ORDER_STRATIFIED;
+        return 0;
+    }
+
+    order->type = ORDER_CUSTOM;
+
+    uint32_t used_bits = 0;
+    const char *curr = str;
+    while (*curr != '\0') {
+        char *endptr;
+        unsigned long bit = strtoul(curr, &endptr, 10);
+
+        if (endptr == curr || bit > 31 || (used_bits & (1u << bit)))
+            return -1;
+
+        used_bits |= (1u << bit);
+        order->bits[order->bit_count++] = bit;
+
+        if (*endptr == ',')
+            ++endptr;
+        else if (*endptr != '\0')
+            return -1;
+        curr = endptr;
+    }
+
+    return order->bit_count == 0 ? -1 : 0;
+}
+
+/*
+ * Sets up an iterator over all instructions in [start, end] that the
+ * mask allows, visited in the given order.
+ *
+ * All orders visit the same set of instructions as the linear order,
+ * just in a different sequence. The non-linear orders are implemented
+ * by counting through the free (masked) bits and depositing the counter
+ * bits in the order given by the bit priority.
+ */
+void init_insn_iterator(insn_iterator *it, insn_order *order,
+                        uint32_t start, uint32_t end, uint64_t mask,
+                        bool thumb)
+{
+    memset(it, 0, sizeof(*it));
+    it->order = *order;
+    it->range_start = start;
+    it->range_end = end;
+    it->mask = mask;
+    it->thumb = thumb;
+    it->next = start;
+
+    /*
+     * Bits above the most significant bit where start and end differ
+     * never change within the range, so don't count through them.
+     */
+    uint32_t free_bits = mask & 0xffffffff;
+    uint32_t range_diff = start ^ end;
+    if (range_diff == 0) {
+        free_bits = 0;
+    } else {
+        free_bits &= (uint32_t)(((uint64_t)1
+                                 << (32 - __builtin_clz(range_diff))) - 1);
+    }
+
+    // 16-bit thumb instructions only use the upper half-word
+    if (thumb && !is_thumb32(end))
+        free_bits &= 0xffff0000;
+
+    it->fixed_bits = start & ~free_bits;
+
+    uint8_t priority[32];
+    uint32_t priority_count = 0;
+    uint32_t listed_bits = 0;
+
+    switch (order->type) {
+        case ORDER_BITREV:
+            for (int32_t bit = 31; bit >= 0; --bit)
+                priority[priority_count++] = bit;
+            break;
+        case ORDER_STRATIFIED:
+            for (int32_t bit = 31; bit >= STRATA_LOW_BIT; --bit)
+                priority[priority_count++] = bit;
+            for (int32_t bit = 0; bit < STRATA_LOW_BIT; ++bit)
+                priority[priority_count++] = bit;
+            break;
+        case ORDER_CUSTOM:
+            for (uint32_t i = 0; i < order->bit_count; ++i) {
+                priority[priority_count++] = order->bits[i];
+                listed_bits |= (1u << order->bits[i]);
+            }
+            // Unlisted bits follow in numeric order
+            for (uint32_t bit = 0; bit < 32; ++bit) {
+                if (!(listed_bits & (1u << bit)))
+                    priority[priority_count++] = bit;
+            }
+            break;
+        case ORDER_LINEAR:
+        default:
+            for (uint32_t bit = 0; bit < 32; ++bit)
+                priority[priority_count++] = bit;
+            break;
+    }
+
+    for (uint32_t i = 0; i < priority_count; ++i) {
+        if (free_bits & (1u << priority[i]))
+            it->bit_map[it->bit_count++] = priority[i];
+    }
+}
+
+/*
+ * Checks whether the traversal visits every encoding of each aligned block
+ * of 2^block_bits encodings it enters, one after the other. That's the case
+ * for the linear order when the mask frees the lowest block_bits bits (and,
+ * for 16-bit thumb, the ones of the upper half-word).
+ */
+bool insn_iterator_is_dense(insn_iterator *it, uint32_t block_bits)
+{
+    if (it->order.type != ORDER_LINEAR)
+        return false;
+
+    uint64_t block_mask = ((uint64_t)1 << block_bits) - 1;
+    if (it->thumb)
+        block_mask |= block_mask << 16;
+    return (it->mask & block_mask) == block_mask;
+}
+
+/*
+ * Stores the next instruction of the traversal in insn.
+ *
+ * Returns false when all instructions have been visited.
+ */
+bool next_insn(insn_iterator *it, uint32_t *insn)
+{
+    if (it->order.type == ORDER_LINEAR) {
+        if (it->next > it->range_end)
+            return false;
+
+        *insn = it->next & 0xffffffff;
+        it->next = get_next_instruction(it->next, it->mask, it->thumb);
+        return true;
+    }
+
+    uint64_t counter_end = (uint64_t)1 << it->bit_count;
+
+    while (it->counter < counter_end) {
+        uint64_t counter = it->counter++;
+        uint32_t candidate = it->fixed_bits;
+
+        for (uint32_t i = 0; counter != 0; ++i, counter >>= 1) {
+            if (counter & 1)
+                candidate |= (1u << it->bit_map[i]);
+        }
+
+        if (candidate < it->range_start || candidate > it->range_end)
+            continue;
+
+        /*
+         * The linear order only increments the upper half-word of 16-bit
+         * thumb instructions, so skip any other lower half-word.
+         */
+        if (it->thumb && !is_thumb32(candidate)
+                && (candidate & 0xffff) != (it->range_start & 0xffff))
+            continue;
+
+        *insn = candidate;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Advances the traversal past its next count instructions, e.g. to resume
+ * a stopped run from the number of instructions it had visited.
+ *
+ * Returns the number of instructions skipped, which is less than count if
+ * the traversal ended.
+ */
+uint64_t skip_insns(insn_iterator *it, uint64_t count)
+{
+    uint32_t insn;
+    uint64_t skipped = 0;
+    while (skipped < count && next_insn(it, &insn))
+        ++skipped;
+    return skipped;
+}
+
+/*
+ * Returns the next instruction based on the current one, taking
+ * the instruction mask and thumb execution into account.
+ *
+ * The insn and mask are 64-bit to prevent overflow, such that the
+ * caller can check whether the instruction is out of bounds.
+ */
+uint64_t get_next_instruction(uint64_t insn, uint64_t mask, bool thumb)
+{
+    if (thumb && !is_thumb32(insn & 0xffffffff)) {
+        /*
+         * Increment upper half, including the "extended" bits
+         * and taking the supplied mask into account
+         */
+        mask &= 0xffffffffffff0000;
+    }
+    return MASKED_INCREMENT(insn, mask);
+}
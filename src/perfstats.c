@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+#include "perfstats.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} counter_defs[PERF_STAT_COUNT] = {
+    [PERF_STAT_CYCLES] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    [PERF_STAT_INSTRUCTIONS] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    [PERF_STAT_CONTEXT_SWITCHES] = {
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "cs"},
+    [PERF_STAT_PAGE_FAULTS] = {
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "faults"},
+    [PERF_STAT_L1I_MISSES] = {
+        PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1I
+            | PERF_COUNT_HW_CACHE_OP_READ << 8
+            | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+        "l1i-misses"},
+};
+
+/*
+ * Opens a counter for the calling process, including the kernel (where
+ * the trap handling happens) if perf_event_paranoid allows it.
+ *
+ * Returns the fd, or -1 if the counter isn't available, and sets
+ * *user_only if it only counts user space.
+ */
+static int open_counter(uint32_t type, uint64_t config, bool *user_only)
+{
+    struct perf_event_attr attr = {
+        .type = type,
+        .size = sizeof(attr),
+        .config = config,
+        .exclude_hv = 1,
+    };
+
+    *user_only = false;
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd == -1 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        *user_only = true;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return fd;
+}
+
+static uint64_t read_counter(int fd)
+{
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    return count;
+}
+
+static void read_cpu_times(uint64_t *utime_us, uint64_t *stime_us)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1) {
+        *utime_us = 0;
+        *stime_us = 0;
+        return;
+    }
+    *utime_us = usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec;
+    *stime_us = usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+}
+
+static void start_region(perf_stats *stats, search_status *status)
+{
+    for (uint32_t i = 0; i < PERF_STAT_COUNT; ++i) {
+        if (stats->fds[i] != -1)
+            stats->start[i] = read_counter(stats->fds[i]);
+    }
+    read_cpu_times(&stats->start_utime_us, &stats->start_stime_us);
+    stats->start_status = *status;
+    stats->disas_ns = 0;
+    stats->exec_ns = 0;
+}
+
+/*
+ * Opens the counters and the region log (data/perf<suffix>). The header
+ * records which counters are available, and whether they include the
+ * kernel (all) or not (user).
+ *
+ * Returns 0 on success and -1 if the log can't be created. Unavailable
+ * counters aren't an error.
+ */
+int open_perf_stats(perf_stats *stats, const char *path)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    stats->fp = fopen(path, "w");
+    if (stats->fp == NULL)
+        return -1;
+
+    fprintf(stats->fp, "# perf:");
+    for (uint32_t i = 0; i < PERF_STAT_COUNT; ++i) {
+        bool user_only;
+        stats->fds[i] = open_counter(counter_defs[i].type,
+                                     counter_defs[i].config, &user_only);
+        fprintf(stats->fp, "%s%s=%s", i > 0 ? "," : "", counter_defs[i].name,
+                stats->fds[i] == -1 ? "n/a" : user_only ? "user" : "all");
+    }
+    fprintf(stats->fp, "\n# first-last,checked,skipped,filtered,hidden");
+    for (uint32_t i = 0; i < PERF_STAT_COUNT; ++i)
+        fprintf(stats->fp, ",%s", counter_defs[i].name);
+    fprintf(stats->fp, ",utime_us,stime_us,disas_ns,exec_ns\n");
+
+    search_status empty = {0};
+    start_region(stats, &empty);
+    return 0;
+}
+
+/*
+ * Writes the counters of the region that ends now, i.e. the encodings
+ * visited since the previous region, and starts a new one. With the linear
+ * order, first-last is a contiguous encoding range.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int write_perf_region(perf_stats *stats, uint32_t first, uint32_t last,
+                      search_status *status)
+{
+    search_status *start = &stats->start_status;
+    uint64_t checked = status->instructions_checked
+                       - start->instructions_checked;
+    uint64_t skipped = status->instructions_skipped
+                       - start->instructions_skipped;
+    uint64_t filtered = status->instructions_filtered
+                        - start->instructions_filtered;
+
+    // Nothing visited since the last region
+    if (checked + skipped + filtered == 0)
+        return 0;
+
+    int ret = 0;
+    if (fprintf(stats->fp, "%08" PRIx32 "-%08" PRIx32 ",%llu,%llu,%llu,%llu",
+                first, last, (unsigned long long)checked,
+                (unsigned long long)skipped, (unsigned long long)filtered,
+                (unsigned long long)(status->hidden_instructions_found
+                                     - start->hidden_instructions_found)) < 0)
+        ret = -1;
+
+    for (uint32_t i = 0; i < PERF_STAT_COUNT; ++i) {
+        if (stats->fds[i] == -1) {
+            fprintf(stats->fp, ",-");
+            continue;
+        }
+        fprintf(stats->fp, ",%llu", (unsigned long long)
+                (read_counter(stats->fds[i]) - stats->start[i]));
+    }
+
+    uint64_t utime_us, stime_us;
+    read_cpu_times(&utime_us, &stime_us);
+    if (fprintf(stats->fp, ",%llu,%llu,%llu,%llu\n",
+                (unsigned long long)(utime_us - stats->start_utime_us),
+                (unsigned long long)(stime_us - stats->start_stime_us),
+                (unsigned long long)stats->disas_ns,
+                (unsigned long long)stats->exec_ns) < 0)
+        ret = -1;
+
+    // Let the completed regions survive a crash
+    fflush(stats->fp);
+
+    start_region(stats, status);
+    return ret;
+}
+
+int close_perf_stats(perf_stats *stats)
+{
+    for (uint32_t i = 0; i < PERF_STAT_COUNT; ++i) {
+        if (stats->fds[i] != -1)
+            close(stats->fds[i]);
+    }
+    int ret = fclose(stats->fp) == 0 ? 0 : -1;
+    stats->fp = NULL;
+    return ret;
+}
@@ -0,0 +1,331 @@
+#define _GNU_SOURCE
+#include "remote.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * The remote executor protocol is a simple batch protocol over a pair of
+ * pipes (the executor's stdin and stdout):
+ *
+ *   1. The fuzzer sends a remote_config, which the executor echoes back.
+ *   2. The fuzzer sends a batch: a uint32_t count followed by count
+ *      instructions (uint32_t each).
+ *   3. The executor executes them, and replies with count
+ *      execution_results (or remote_results, with REMOTE_FLAG_COMPACT).
+ *   4. Repeat from 2. until the fuzzer closes the pipe.
+ */
+
+static int read_full(int fd, void *buf, size_t length)
+{
+    uint8_t *ptr = buf;
+    while (length > 0) {
+        ssize_t ret = read(fd, ptr, length);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return ret == 0 ? 0 : -1;
+        ptr += ret;
+        length -= ret;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void *buf, size_t length)
+{
+    const uint8_t *ptr = buf;
+    while (length > 0) {
+        ssize_t ret = write(fd, ptr, length);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        ptr += ret;
+        length -= ret;
+    }
+    return 0;
+}
+
+/*
+ * Starts the executor by running cmd with the --exec-server option
+ * appended, e.g. "qemu-aarch64 ./fuzzer", and sends it the config.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int spawn_remote_executor(remote_executor *remote, const char *cmd,
+                          remote_config *config)
+{
+    int to_pipe[2];
+    int from_pipe[2];
+
+    if (pipe(to_pipe) == -1)
+        return -1;
+    if (pipe(from_pipe) == -1) {
+        close(to_pipe[0]);
+        close(to_pipe[1]);
+        return -1;
+    }
+
+    char *full_cmd;
+    if (asprintf(&full_cmd, "%s --exec-server", cmd) == -1)
+        return -1;
+
+    remote->pid = fork();
+    if (remote->pid == 0) {
+        dup2(to_pipe[0], STDIN_FILENO);
+        dup2(from_pipe[1], STDOUT_FILENO);
+        close(to_pipe[0]);
+        close(to_pipe[1]);
+        close(from_pipe[0]);
+        close(from_pipe[1]);
+        execl("/bin/sh", "sh", "-c", full_cmd, (char*)NULL);
+        _exit(127);
+    }
+
+    free(full_cmd);
+    close(to_pipe[0]);
+    close(from_pipe[1]);
+    remote->to_fd = to_pipe[1];
+    remote->from_fd = from_pipe[0];
+
+    if (remote->pid == -1) {
+        stop_remote_executor(remote);
+        return -1;
+    }
+
+    remote->compact = config->flags & REMOTE_FLAG_COMPACT;
+    size_t result_size = remote->compact ? sizeof(remote_result)
+                                         : sizeof(execution_result);
+
+    config->magic = REMOTE_MAGIC;
+    config->result_size = result_size;
+
+    remote_config reply;
+    if (write_remote_config(remote->to_fd, config) == -1
+            || read_remote_config(remote->from_fd, &reply) != 1) {
+        stop_remote_executor(remote);
+        return -1;
+    }
+
+    if (reply.result_size != result_size) {
+        fprintf(stderr, "ERROR: The remote executor uses a different "
+                        "result format. Is it built for the same ISA?\n");
+        stop_remote_executor(remote);
+        return -1;
+    }
+
+    return 0;
+}
+
+int remote_submit_batch(remote_executor *remote, uint32_t *insns,
+                        uint32_t count)
+{
+    if (write_full(remote->to_fd, &count, sizeof(count)) == -1
+            || write_full(remote->to_fd, insns, count * sizeof(*insns)) == -1)
+        return -1;
+    return 0;
+}
+
+static void pack_result(execution_result *result, remote_result *packed)
+{
+    *packed = (remote_result){
+        .insn = result->insn,
+        .signal = result->signal,
+        .died = result->died,
+        .timed_out = result->timed_out,
+        .sig_code = result->sig_code,
+        .sig_addr = result->sig_addr,
+        .syscall = result->syscall,
+        .mem_change_count = result->mem_change_count,
+        .sandbox_base = result->sandbox_base,
+        .mem_bytes_dropped = result->mem_bytes_dropped,
+    };
+    memcpy(packed->mem_changes, result->mem_changes,
+           sizeof(packed->mem_changes));
+}
+
+/*
+ * The registers of a compact result are left zeroed, as they are in the
+ * executor's register format.
+ */
+static void unpack_result(remote_result *packed, execution_result *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->insn = packed->insn;
+    result->signal = packed->signal;
+    result->died = packed->died;
+    result->timed_out = packed->timed_out;
+    result->sig_code = packed->sig_code;
+    result->sig_addr = packed->sig_addr;
+    result->syscall = packed->syscall;
+    result->mem_change_count = packed->mem_change_count;
+    result->sandbox_base = packed->sandbox_base;
+    result->mem_bytes_dropped = packed->mem_bytes_dropped;
+    memcpy(result->mem_changes, packed->mem_changes,
+           sizeof(result->mem_changes));
+}
+
+int remote_collect_results(remote_executor *remote, execution_result *results,
+                           uint32_t count)
+{
+    if (!remote->compact) {
+        if (read_full(remote->from_fd, results,
+                      count * sizeof(*results)) != 1)
+            return -1;
+        return 0;
+    }
+
+    static remote_result packed[REMOTE_BATCH_SIZE];
+    if (read_full(remote->from_fd, packed, count * sizeof(*packed)) != 1)
+        return -1;
+    for (uint32_t i = 0; i < count; ++i)
+        unpack_result(&packed[i], &results[i]);
+    return 0;
+}
+
+void stop_remote_executor(remote_executor *remote)
+{
+    // Closing the pipe makes the executor quit
+    close(remote->to_fd);
+    close(remote->from_fd);
+    if (remote->pid > 0)
+        waitpid(remote->pid, NULL, 0);
+    remote->pid = 0;
+}
+
+/*
+ * Returns 1 if a config was read, 0 on EOF and -1 if it's invalid.
+ */
+int read_remote_config(int fd, remote_config *config)
+{
+    int ret = read_full(fd, config, sizeof(*config));
+    if (ret != 1)
+        return ret;
+    return config->magic == REMOTE_MAGIC ? 1 : -1;
+}
+
+int write_remote_config(int fd, remote_config *config)
+{
+    return write_full(fd, config, sizeof(*config));
+}
+
+/*
+ * Returns 1 if a batch was read, 0 on EOF and -1 on errors.
+ */
+int read_remote_batch(int fd, uint32_t *insns, uint32_t *count)
+{
+    int ret = read_full(fd, count, sizeof(*count));
+    if (ret != 1)
+        return ret;
+    if (*count > REMOTE_BATCH_SIZE)
+        return -1;
+    return read_full(fd, insns, *count * sizeof(*insns)) == 1 ? 1 : -1;
+}
+
+int write_remote_results(int fd, execution_result *results, uint32_t count,
+                         bool compact)
+{
+    if (!compact)
+        return write_full(fd, results, count * sizeof(*results));
+
+    static remote_result packed[REMOTE_BATCH_SIZE];
+    for (uint32_t i = 0; i < count; ++i)
+        pack_result(&results[i], &packed[i]);
+    return write_full(fd, packed, count * sizeof(*packed));
+}
+
+/*
+ * Checks whether two executions of the same instruction had different
+ * effects. The pc is compared relative to the pc before execution, as the
+ * two executors don't share an address space.
+ */
+bool results_diverge(execution_result *a, execution_result *b,
+                     bool compare_regs, bool include_vector_regs)
+{
+    if (a->signal != b->signal || a->timed_out != b->timed_out)
+        return true;
+
+    // E.g. ILL_PRVOPC on one side and ILL_ILLOPC on the other
+    if (a->signal != 0 && !a->timed_out && a->sig_code != b->sig_code)
+        return true;
+
+    // Memory effects are relative to the register base with --sandbox
+    if (a->sandbox_base != 0 && b->sandbox_base != 0) {
+        if (si_addr_is_data(a->signal)
+                && si_addr_is_valid(a->signal, a->sig_code)
+                && a->sig_addr - a->sandbox_base
+                   != b->sig_addr - b->sandbox_base)
+            return true;
+
+        if (a->mem_change_count != b->mem_change_count
+                || a->mem_bytes_dropped != b->mem_bytes_dropped
+                || memcmp(a->mem_changes, b->mem_changes,
+                          a->mem_change_count * sizeof(mem_change)) != 0)
+            return true;
+    }
+
+    if (!compare_regs)
+        return false;
+
+    // So are the general registers, as the arenas are mapped at different
+    // addresses in the two executors
+    uint64_t base_a = 0, base_b = 0;
+    if (a->sandbox_base != 0 && b->sandbox_base != 0) {
+        base_a = a->sandbox_base;
+        base_b = b->sandbox_base;
+    }
+
+#ifdef __aarch64__
+    for (uint32_t i = 0; i < UREG_COUNT; ++i) {
+        if (a->regs_after.regs[i] - base_a != b->regs_after.regs[i] - base_b)
+            return true;
+    }
+
+    if (a->regs_after.sp - base_a != b->regs_after.sp - base_b
+            || a->regs_after.pstate != b->regs_after.pstate
+            || a->regs_after.pc - a->regs_before.pc
+               != b->regs_after.pc - b->regs_before.pc)
+        return true;
+
+    if (include_vector_regs) {
+        for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+            if (a->vfp_regs_after.vregs[i] != b->vfp_regs_after.vregs[i])
+                return true;
+        }
+        if (a->vfp_regs_after.fpsr != b->vfp_regs_after.fpsr
+                || a->vfp_regs_after.fpcr != b->vfp_regs_after.fpcr)
+            return true;
+    }
+#else
+    for (uint32_t i = 0; i < UREG_COUNT; ++i) {
+        if (i == A32_ORIG_r0)
+            continue;
+
+        if (i == A32_pc) {
+            if (a->regs_after.uregs[i] - a->regs_before.uregs[i]
+                    != b->regs_after.uregs[i] - b->regs_before.uregs[i])
+                return true;
+        } else if (i == A32_cpsr) {
+            if (a->regs_after.uregs[i] != b->regs_after.uregs[i])
+                return true;
+        } else if ((uint32_t)(a->regs_after.uregs[i] - base_a)
+                   != (uint32_t)(b->regs_after.uregs[i] - base_b)) {
+            return true;
+        }
+    }
+
+    if (include_vector_regs) {
+        for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+            if (a->vfp_regs_after.fpregs[i] != b->vfp_regs_after.fpregs[i])
+                return true;
+        }
+        if (a->vfp_regs_after.fpscr != b->vfp_regs_after.fpscr)
+            return true;
+    }
+#endif
+
+    return false;
+}
@@ -0,0 +1,173 @@
+#include "resmap.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char *RESULT_CLASS_STR[] = {
+    [RESULT_UNVISITED] = "unvisited",
+    [RESULT_SKIPPED] = "skipped",
+    [RESULT_FILTERED] = "filtered",
+    [RESULT_UNEXECUTED] = "unexecuted",
+    [RESULT_SIGILL] = "sigill",
+    [RESULT_SIGSEGV] = "sigsegv",
+    [RESULT_SIGTRAP] = "sigtrap",
+    [RESULT_SIGBUS] = "sigbus",
+    [RESULT_NO_SIGNAL] = "nosignal",
+    [RESULT_OTHER_SIGNAL] = "other",
+    [RESULT_TIMEOUT] = "timeout",
+    [RESULT_SYSCALL] = "syscall",
+};
+
+result_class result_class_from_signal(int signum)
+{
+    switch (signum) {
+        case 0: return RESULT_NO_SIGNAL;
+        case SIGILL: return RESULT_SIGILL;
+        case SIGSEGV: return RESULT_SIGSEGV;
+        case SIGTRAP: return RESULT_SIGTRAP;
+        case SIGBUS: return RESULT_SIGBUS;
+        case SIGSYS: return RESULT_SYSCALL;
+        default: return RESULT_OTHER_SIGNAL;
+    }
+}
+
+const char *result_class_name(result_class class)
+{
+    if (class >= RESULT_CLASS_COUNT || RESULT_CLASS_STR[class] == NULL)
+        return "unknown";
+    return RESULT_CLASS_STR[class];
+}
+
+/*
+ * Reads and validates the header of a result map.
+ *
+ * Returns 0 if the header is valid, 1 if it is all zeros (i.e. the file
+ * was just created by another worker) and -1 otherwise.
+ */
+int read_result_map_header(int fd, result_map_header *header)
+{
+    if (pread(fd, header, sizeof(*header), 0) != sizeof(*header))
+        return -1;
+
+    if (memcmp(header->magic, RESULT_MAP_MAGIC, sizeof(header->magic)) == 0) {
+        if (header->version != RESULT_MAP_VERSION
+                || header->bits_per_entry != RESULT_MAP_BITS_PER_ENTRY) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+
+    static const result_map_header zero_header = {0};
+    if (memcmp(header, &zero_header, sizeof(*header)) == 0)
+        return 1;
+
+    errno = EINVAL;
+    return -1;
+}
+
+/*
+ * Opens (and creates if needed) the result map at path, and maps the part
+ * of the file covering [range_start, range_end]. The file always covers the
+ * whole instruction space, so several workers can share one map and write
+ * their own slice of it in place.
+ *
+ * Returns 0 on success and -1 on failure (with errno set).
+ */
+int open_result_map(result_map *map, const char *path, uint32_t isa,
+                    uint32_t range_start, uint32_t range_end)
+{
+    memset(map, 0, sizeof(*map));
+
+    map->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (map->fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(map->fd, &st) == -1)
+        goto fail;
+
+    // Other workers might be doing the same, but that's fine
+    if ((uint64_t)st.st_size != RESULT_MAP_SIZE
+            && ftruncate(map->fd, RESULT_MAP_SIZE) == -1)
+        goto fail;
+
+    result_map_header header;
+    int header_ret = read_result_map_header(map->fd, &header);
+    if (header_ret == -1) {
+        goto fail;
+    } else if (header_ret == 1) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RESULT_MAP_MAGIC, sizeof(header.magic));
+        header.version = RESULT_MAP_VERSION;
+        header.bits_per_entry = RESULT_MAP_BITS_PER_ENTRY;
+        header.isa = isa;
+        if (pwrite(map->fd, &header, sizeof(header), 0) != sizeof(header))
+            goto fail;
+    } else if (header.isa != isa) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t first_byte = RESULT_MAP_HEADER_SIZE + range_start / 2;
+    uint64_t last_byte = RESULT_MAP_HEADER_SIZE + range_end / 2;
+
+    map->mapping_offset = first_byte & ~(page_size - 1);
+    map->mapping_length = last_byte - map->mapping_offset + 1;
+    map->mapping = mmap(NULL, map->mapping_length, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, map->fd, map->mapping_offset);
+
+    if (map->mapping == MAP_FAILED) {
+        map->mapping = NULL;
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    close(map->fd);
+    map->fd = -1;
+    return -1;
+}
+
+/*
+ * Stores the class of insn in the map. Two neighbouring encodings share a
+ * byte, which might belong to two different workers at slice boundaries,
+ * so the nibble is updated atomically.
+ */
+void set_result(result_map *map, uint32_t insn, result_class class)
+{
+    uint8_t *byte = &map->mapping[RESULT_MAP_HEADER_SIZE + insn / 2
+                                  - map->mapping_offset];
+    uint32_t shift = (insn & 1) * 4;
+
+    uint8_t old_val = __atomic_load_n(byte, __ATOMIC_RELAXED);
+    uint8_t new_val;
+    do {
+        new_val = (old_val & ~(0xf << shift)) | ((class & 0xf) << shift);
+    } while (!__atomic_compare_exchange_n(byte, &old_val, new_val, true,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+}
+
+result_class get_result(result_map *map, uint32_t insn)
+{
+    uint8_t byte = map->mapping[RESULT_MAP_HEADER_SIZE + insn / 2
+                                - map->mapping_offset];
+    return (byte >> ((insn & 1) * 4)) & 0xf;
+}
+
+void close_result_map(result_map *map)
+{
+    if (map->mapping != NULL)
+        munmap(map->mapping, map->mapping_length);
+    if (map->fd != -1)
+        close(map->fd);
+    map->mapping = NULL;
+    map->fd = -1;
+}
@@ -0,0 +1,321 @@
+#include "rlemap.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Records read at a time by the reader
+#define RLE_READ_BUF_COUNT 4096
+
+int open_rle_writer(rle_writer *writer, const char *path, uint32_t isa)
+{
+    memset(writer, 0, sizeof(*writer));
+
+    writer->fp = fopen(path, "w");
+    if (writer->fp == NULL)
+        return -1;
+
+    rle_map_header header = {0};
+    memcpy(header.magic, RLE_MAP_MAGIC, sizeof(header.magic));
+    header.version = RLE_MAP_VERSION;
+    header.isa = isa;
+
+    if (fwrite(&header, sizeof(header), 1, writer->fp) != 1) {
+        fclose(writer->fp);
+        writer->fp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int write_record(rle_writer *writer, rle_record *record)
+{
+    if (writer->record_count % RLE_INDEX_STRIDE == 0) {
+        if (writer->index_count == writer->index_capacity) {
+            uint32_t new_capacity = writer->index_capacity == 0
+                                    ? 1024 : writer->index_capacity * 2;
+            uint32_t *new_index = realloc(writer->index,
+                                          new_capacity * sizeof(uint32_t));
+            if (new_index == NULL)
+                return -1;
+            writer->index = new_index;
+            writer->index_capacity = new_capacity;
+        }
+        writer->index[writer->index_count++] = record->first;
+    }
+
+    if (fwrite(record, sizeof(*record), 1, writer->fp) != 1)
+        return -1;
+
+    ++writer->record_count;
+    return 0;
+}
+
+/*
+ * Appends a run of encodings to the map, extending the current run if
+ * possible. Runs must be appended in increasing order.
+ *
+ * Returns 0 on success and -1 on failure (errno is EINVAL if the run
+ * overlaps with or comes before the previous one).
+ */
+int rle_append_run(rle_writer *writer, rle_record *record)
+{
+    if (writer->run_active) {
+        if (record->first <= writer->run.last) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        if (record->class == writer->run.class
+                && record->first == writer->run.last + 1) {
+            writer->run.last = record->last;
+            return 0;
+        }
+
+        if (write_record(writer, &writer->run) == -1)
+            return -1;
+    }
+
+    writer->run = *record;
+    writer->run_active = true;
+    return 0;
+}
+
+int rle_append(rle_writer *writer, uint32_t insn, result_class class)
+{
+    // Fast path for the common case of extending the current run
+    if (writer->run_active
+            && writer->run.class == class
+            && writer->run.last + 1 == insn
+            && insn != 0) {
+        writer->run.last = insn;
+        return 0;
+    }
+
+    rle_record record = {
+        .first = insn,
+        .last = insn,
+        .class = class,
+    };
+    return rle_append_run(writer, &record);
+}
+
+/*
+ * Flushes all completed runs to the file, so that they survive a crash.
+ */
+int flush_rle_writer(rle_writer *writer)
+{
+    return fflush(writer->fp) == 0 ? 0 : -1;
+}
+
+/*
+ * Writes the last run, the index and the footer, and closes the file.
+ */
+int close_rle_writer(rle_writer *writer)
+{
+    int ret = 0;
+
+    if (writer->run_active && write_record(writer, &writer->run) == -1)
+        ret = -1;
+
+    rle_map_footer footer = {
+        .record_count = writer->record_count,
+        .index_stride = RLE_INDEX_STRIDE,
+        .index_count = writer->index_count,
+    };
+    memcpy(footer.magic, RLE_MAP_FOOTER_MAGIC, sizeof(footer.magic));
+
+    if (writer->index_count > 0
+            && fwrite(writer->index, sizeof(uint32_t), writer->index_count,
+                      writer->fp) != writer->index_count)
+        ret = -1;
+
+    if (fwrite(&footer, sizeof(footer), 1, writer->fp) != 1)
+        ret = -1;
+
+    if (fclose(writer->fp) != 0)
+        ret = -1;
+
+    free(writer->index);
+    memset(writer, 0, sizeof(*writer));
+    return ret;
+}
+
+static int fill_read_buf(rle_reader *reader, uint64_t first_record)
+{
+    uint64_t count = reader->record_count - first_record;
+    if (count > RLE_READ_BUF_COUNT)
+        count = RLE_READ_BUF_COUNT;
+
+    off_t offset = sizeof(rle_map_header) + first_record * sizeof(rle_record);
+    ssize_t length = count * sizeof(rle_record);
+    if (pread(reader->fd, reader->buf, length, offset) != length)
+        return -1;
+
+    reader->buf_first_record = first_record;
+    reader->buf_count = count;
+    return 0;
+}
+
+/*
+ * Builds the index of a map that was never closed properly, by reading
+ * through all the records.
+ */
+static int rebuild_index(rle_reader *reader)
+{
+    reader->index_count = (reader->record_count + RLE_INDEX_STRIDE - 1)
+                          / RLE_INDEX_STRIDE;
+    reader->index = malloc((reader->index_count + 1) * sizeof(uint32_t));
+    if (reader->index == NULL)
+        return -1;
+
+    for (uint64_t rec = 0; rec < reader->record_count;
+            rec += RLE_READ_BUF_COUNT) {
+        if (fill_read_buf(reader, rec) == -1)
+            return -1;
+        for (uint32_t i = 0; i < reader->buf_count; ++i) {
+            if ((rec + i) % RLE_INDEX_STRIDE == 0)
+                reader->index[(rec + i) / RLE_INDEX_STRIDE] =
+                    reader->buf[i].first;
+        }
+    }
+    reader->buf_count = 0;
+    return 0;
+}
+
+int open_rle_reader(rle_reader *reader, const char *path)
+{
+    memset(reader, 0, sizeof(*reader));
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd == -1)
+        return -1;
+
+    rle_map_header header;
+    if (pread(reader->fd, &header, sizeof(header), 0) != sizeof(header)
+            || memcmp(header.magic, RLE_MAP_MAGIC, sizeof(header.magic)) != 0
+            || header.version != RLE_MAP_VERSION) {
+        errno = EINVAL;
+        goto fail;
+    }
+    reader->isa = header.isa;
+
+    reader->buf = malloc(RLE_READ_BUF_COUNT * sizeof(rle_record));
+    if (reader->buf == NULL)
+        goto fail;
+
+    struct stat st;
+    if (fstat(reader->fd, &st) == -1)
+        goto fail;
+
+    uint64_t body_size = st.st_size - sizeof(header);
+
+    rle_map_footer footer;
+    if (body_size >= sizeof(footer)
+            && pread(reader->fd, &footer, sizeof(footer),
+                     st.st_size - sizeof(footer)) == sizeof(footer)
+            && memcmp(footer.magic, RLE_MAP_FOOTER_MAGIC,
+                      sizeof(footer.magic)) == 0
+            && footer.index_stride == RLE_INDEX_STRIDE
+            && footer.record_count * sizeof(rle_record)
+               + footer.index_count * sizeof(uint32_t)
+               + sizeof(footer) == body_size) {
+        reader->record_count = footer.record_count;
+        reader->index_count = footer.index_count;
+        reader->index = malloc((reader->index_count + 1) * sizeof(uint32_t));
+        if (reader->index == NULL)
+            goto fail;
+
+        off_t offset = sizeof(header)
+                       + reader->record_count * sizeof(rle_record);
+        ssize_t length = reader->index_count * sizeof(uint32_t);
+        if (pread(reader->fd, reader->index, length, offset) != length)
+            goto fail;
+    } else {
+        // Unterminated map, so only trust the complete records
+        reader->record_count = body_size / sizeof(rle_record);
+        if (rebuild_index(reader) == -1)
+            goto fail;
+    }
+
+    return 0;
+
+fail:
+    close_rle_reader(reader);
+    return -1;
+}
+
+/*
+ * Reads the next record into record.
+ *
+ * Returns 1 if a record was read, 0 at the end of the map and -1 on errors.
+ */
+int rle_next(rle_reader *reader, rle_record *record)
+{
+    if (reader->next_record >= reader->record_count)
+        return 0;
+
+    if (reader->next_record < reader->buf_first_record
+            || reader->next_record
+               >= reader->buf_first_record + reader->buf_count) {
+        if (fill_read_buf(reader, reader->next_record) == -1)
+            return -1;
+    }
+
+    *record = reader->buf[reader->next_record - reader->buf_first_record];
+    ++reader->next_record;
+    return 1;
+}
+
+/*
+ * Positions the reader such that the next record returned by rle_next is
+ * the first one ending at or after insn.
+ */
+int rle_seek(rle_reader *reader, uint32_t insn)
+{
+    // Find the last index entry starting at or before insn
+    uint32_t low = 0;
+    uint32_t high = reader->index_count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (reader->index[mid] <= insn)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    reader->next_record = (uint64_t)low * RLE_INDEX_STRIDE;
+
+    rle_record record;
+    int ret;
+    while ((ret = rle_next(reader, &record)) == 1) {
+        if (record.last >= insn) {
+            --reader->next_record;
+            break;
+        }
+    }
+    return ret == -1 ? -1 : 0;
+}
+
+result_class rle_lookup(rle_reader *reader, uint32_t insn)
+{
+    rle_record record;
+    if (rle_seek(reader, insn) == -1 || rle_next(reader, &record) != 1)
+        return RESULT_UNVISITED;
+
+    if (record.first <= insn && insn <= record.last)
+        return record.class;
+    return RESULT_UNVISITED;
+}
+
+void close_rle_reader(rle_reader *reader)
+{
+    if (reader->fd != -1)
+        close(reader->fd);
+    free(reader->index);
+    free(reader->buf);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
@@ -0,0 +1,153 @@
+#include "sandbox.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#ifdef __aarch64__
+#define SECCOMP_AUDIT_ARCH AUDIT_ARCH_AARCH64
+#else
+#define SECCOMP_AUDIT_ARCH AUDIT_ARCH_ARM
+#endif
+
+#define SECCOMP_DATA_OFFSET(field) offsetof(struct seccomp_data, field)
+
+static inline uint32_t pattern_word(size_t index)
+{
+    return SANDBOX_PATTERN_TAG | (index & 0xffff);
+}
+
+static void fill_arena(uint8_t *arena, size_t offset, size_t length)
+{
+    uint32_t *words = (uint32_t*)(arena + offset);
+    for (size_t i = 0; i < length / 4; ++i)
+        words[i] = pattern_word(offset / 4 + i);
+}
+
+int init_scratch_arena(scratch_arena *sandbox)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    sandbox->mapping_length = SANDBOX_ARENA_SIZE + 2 * page_size;
+    sandbox->mapping = mmap(NULL, sandbox->mapping_length, PROT_NONE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sandbox->mapping == MAP_FAILED)
+        return -1;
+
+    sandbox->arena = sandbox->mapping + page_size;
+    if (mprotect(sandbox->arena, SANDBOX_ARENA_SIZE,
+                 PROT_READ | PROT_WRITE) == -1) {
+        munmap(sandbox->mapping, sandbox->mapping_length);
+        return -1;
+    }
+
+    sandbox->base = (uintptr_t)sandbox->arena + SANDBOX_ARENA_SIZE / 2;
+    fill_arena(sandbox->arena, 0, SANDBOX_ARENA_SIZE);
+    return 0;
+}
+
+/*
+ * Records the byte ranges of the arena that differ from the pattern in the
+ * execution result, relative to the base, and restores the pattern.
+ *
+ * Only instructions that didn't raise SIGILL can have written to the arena,
+ * so this is only needed after hidden instructions.
+ */
+void find_arena_changes(scratch_arena *sandbox, execution_result *result)
+{
+    const uint64_t *words = (const uint64_t*)sandbox->arena;
+    bool in_range = false;
+
+    result->mem_change_count = 0;
+    result->mem_bytes_dropped = 0;
+
+    for (size_t i = 0; i < SANDBOX_ARENA_SIZE / 8; ++i) {
+        uint64_t expected = ((uint64_t)pattern_word(2 * i + 1) << 32)
+                            | pattern_word(2 * i);
+
+        // Fast path: compare 8 bytes at a time
+        if (words[i] == expected) {
+            in_range = false;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < 8; ++j) {
+            size_t offset = i * 8 + j;
+            bool changed = sandbox->arena[offset]
+                           != ((const uint8_t*)&expected)[j];
+
+            if (!changed) {
+                in_range = false;
+                continue;
+            }
+
+            if (in_range) {
+                ++result->mem_changes[result->mem_change_count - 1].length;
+            } else if (result->mem_change_count < MAX_MEM_CHANGES) {
+                result->mem_changes[result->mem_change_count++] =
+                    (mem_change) {
+                        .offset = offset - SANDBOX_ARENA_SIZE / 2,
+                        .length = 1,
+                    };
+                in_range = true;
+            } else {
+                ++result->mem_bytes_dropped;
+            }
+        }
+
+        fill_arena(sandbox->arena, i * 8, 8);
+    }
+}
+
+void free_scratch_arena(scratch_arena *sandbox)
+{
+    munmap(sandbox->mapping, sandbox->mapping_length);
+}
+
+/*
+ * Installs a seccomp filter that makes every syscall issued from the given
+ * (page aligned) code region raise SIGSYS instead of being executed, while
+ * syscalls from anywhere else (i.e. the fuzzer itself) are allowed. Hidden
+ * instructions that behave like svc are thereby caught without ptrace.
+ *
+ * The filter can't be removed again, and is inherited by child processes.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int install_syscall_trap(void *code, size_t length)
+{
+    uint64_t start = (uintptr_t)code;
+    uint32_t region_mask = ~(uint32_t)(length - 1);
+
+    // seccomp_data is little endian, so the upper half of a field comes last
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SECCOMP_DATA_OFFSET(arch)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SECCOMP_AUDIT_ARCH, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                 SECCOMP_DATA_OFFSET(instruction_pointer) + 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)(start >> 32), 0, 3),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                 SECCOMP_DATA_OFFSET(instruction_pointer)),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, region_mask),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)start, 1, 0),
+
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+    };
+
+    struct sock_fprog prog = {
+        .len = sizeof(filter) / sizeof(*filter),
+        .filter = filter,
+    };
+
+    // Required to install a filter without CAP_SYS_ADMIN
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1)
+        return -1;
+
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+}
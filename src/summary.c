@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include "summary.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TRANSFORM_STR[] = {
+    "zero",
+    "ones",
+    "small",
+    "copy",
+    "other"
+};
+
+#ifdef __aarch64__
+#define REG_WORD_ONES UINT64_MAX
+#else
+#define REG_WORD_ONES UINT32_MAX
+#endif
+
+// Register changes smaller than this are classified as small
+#define TRANSFORM_SMALL_LIMIT 0x1000
+
+static uint64_t reg_before(execution_result *result, uint32_t i)
+{
+#ifdef __aarch64__
+    if (i == 31)
+        return result->regs_before.sp;
+    if (i == 32)
+        return result->regs_before.pstate;
+    return result->regs_before.regs[i];
+#else
+    return result->regs_before.uregs[i];
+#endif
+}
+
+static uint64_t reg_after(execution_result *result, uint32_t i)
+{
+#ifdef __aarch64__
+    if (i == 31)
+        return result->regs_after.sp;
+    if (i == 32)
+        return result->regs_after.pstate;
+    return result->regs_after.regs[i];
+#else
+    return result->regs_after.uregs[i];
+#endif
+}
+
+// Registers in the signature, excluding the pc (which is a delta)
+static bool is_signature_reg(uint32_t i)
+{
+#ifdef __aarch64__
+    return i <= 32;
+#else
+    return i < UREG_COUNT && i != A32_pc && i != A32_ORIG_r0;
+#endif
+}
+
+// Flags registers aren't classified, as they aren't values
+static bool is_flags_reg(uint32_t i)
+{
+#ifdef __aarch64__
+    return i == 32;
+#else
+    return i == A32_cpsr;
+#endif
+}
+
+static void write_reg_name(FILE *fp, uint32_t i)
+{
+#ifdef __aarch64__
+    if (i == 31)
+        fprintf(fp, "sp");
+    else if (i == 32)
+        fprintf(fp, "pstate");
+    else
+        fprintf(fp, "x%" PRIu32, i);
+#else
+    fprintf(fp, "%s", REG_STR[i]);
+#endif
+}
+
+static uint8_t classify_transform(execution_result *result, uint32_t i)
+{
+    uint64_t before = reg_before(result, i);
+    uint64_t after = reg_after(result, i);
+
+    if (after == 0)
+        return TRANSFORM_ZERO;
+    if (after == REG_WORD_ONES)
+        return TRANSFORM_ONES;
+
+    uint64_t delta = after - before;
+    if (delta < TRANSFORM_SMALL_LIMIT || -delta < TRANSFORM_SMALL_LIMIT)
+        return TRANSFORM_SMALL;
+
+    // The value of another register, e.g. a hidden mov
+    for (uint32_t j = 0; j < 64; ++j) {
+        if (j != i && is_signature_reg(j) && !is_flags_reg(j)
+                && reg_before(result, j) == after)
+            return TRANSFORM_COPY;
+    }
+    return TRANSFORM_OTHER;
+}
+
+static void compute_signature(execution_result *result, bool with_regs,
+                              bool with_vector_regs, hit_signature *sig)
+{
+    memset(sig, 0, sizeof(*sig));
+    sig->signal = result->signal;
+    sig->sig_code = result->signal != 0 && !result->timed_out
+                    ? result->sig_code : 0;
+    sig->timed_out = result->timed_out;
+    sig->wrote_mem = result->mem_change_count > 0
+                     || result->mem_bytes_dropped > 0;
+
+    if (!with_regs)
+        return;
+
+    for (uint32_t i = 0; i < 64; ++i) {
+        if (!is_signature_reg(i) || reg_before(result, i) == reg_after(result, i))
+            continue;
+        sig->regs_changed |= 1ULL << i;
+        if (!is_flags_reg(i))
+            sig->transforms |= classify_transform(result, i);
+    }
+
+#ifdef __aarch64__
+    sig->pc_delta = result->regs_after.pc - result->regs_before.pc;
+#else
+    sig->pc_delta = (int32_t)(result->regs_after.uregs[A32_pc]
+                              - result->regs_before.uregs[A32_pc]);
+#endif
+
+    if (!with_vector_regs)
+        return;
+
+    for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+#ifdef __aarch64__
+        if (result->vfp_regs_before.vregs[i] != result->vfp_regs_after.vregs[i])
+#else
+        if (result->vfp_regs_before.fpregs[i]
+                != result->vfp_regs_after.fpregs[i])
+#endif
+            sig->vregs_changed |= 1U << i;
+    }
+#ifdef __aarch64__
+    sig->fp_status_changed =
+        result->vfp_regs_before.fpsr != result->vfp_regs_after.fpsr
+        || result->vfp_regs_before.fpcr != result->vfp_regs_after.fpcr;
+#else
+    sig->fp_status_changed =
+        result->vfp_regs_before.fpscr != result->vfp_regs_after.fpscr;
+#endif
+}
+
+// FNV-1a
+static uint32_t hash_signature(hit_signature *sig)
+{
+    const uint8_t *bytes = (const uint8_t*)sig;
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < sizeof(*sig); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * Returns the entry of the signature, which is added if it's new, or NULL
+ * if the table is full.
+ */
+static signature_entry *find_signature(hit_summary *summary,
+                                       hit_signature *sig)
+{
+    const uint32_t size = sizeof(summary->entries) / sizeof(*summary->entries);
+    uint32_t i = hash_signature(sig) % size;
+
+    while (summary->entries[i].used) {
+        if (memcmp(&summary->entries[i].sig, sig, sizeof(*sig)) == 0)
+            return &summary->entries[i];
+        i = (i + 1) % size;
+    }
+
+    if (summary->signature_count == SUMMARY_MAX_SIGNATURES)
+        return NULL;
+
+    hit_group *groups = malloc(SUMMARY_MAX_GROUPS * sizeof(*groups));
+    if (groups == NULL)
+        return NULL;
+
+    signature_entry *entry = &summary->entries[i];
+    entry->used = true;
+    entry->sig = *sig;
+    entry->count = 0;
+    entry->group_count = 0;
+    entry->groups = groups;
+    ++summary->signature_count;
+    return entry;
+}
+
+/*
+ * Merges the groups that a generalised group now covers.
+ */
+static void merge_duplicate_groups(signature_entry *entry, uint32_t changed)
+{
+    hit_group *group = &entry->groups[changed];
+
+    for (uint32_t i = 0; i < entry->group_count; ) {
+        hit_group *other = &entry->groups[i];
+        if (i == changed || (other->mask & group->mask) != group->mask
+                || ((other->value ^ group->value) & group->mask) != 0) {
+            ++i;
+            continue;
+        }
+
+        group->count += other->count;
+        // Fill the hole with the last group
+        uint32_t last = --entry->group_count;
+        if (changed == last)
+            changed = i;
+        entry->groups[i] = entry->groups[last];
+        group = &entry->groups[changed];
+    }
+}
+
+/*
+ * Adds an encoding to the groups of its signature. An encoding that
+ * differs from a group in a single fixed bit frees that bit, so that
+ * operand fields are merged as a linear search sweeps through them. If
+ * there's no room for a new group, the encoding joins the nearest one.
+ */
+static void add_to_groups(signature_entry *entry, uint32_t insn)
+{
+    uint32_t nearest = 0;
+    int nearest_distance = 33;
+
+    for (uint32_t i = 0; i < entry->group_count; ++i) {
+        hit_group *group = &entry->groups[i];
+        int distance = __builtin_popcount((insn ^ group->value) & group->mask);
+        if (distance < nearest_distance) {
+            nearest = i;
+            nearest_distance = distance;
+        }
+        if (distance == 0)
+            break;
+    }
+
+    if (nearest_distance > 1 && entry->group_count < SUMMARY_MAX_GROUPS) {
+        entry->groups[entry->group_count++] = (hit_group){
+            .value = insn,
+            .mask = 0xffffffff,
+            .count = 1,
+        };
+        return;
+    }
+
+    hit_group *group = &entry->groups[nearest];
+    ++group->count;
+    if (nearest_distance > 0) {
+        group->mask &= ~(insn ^ group->value);
+        group->value &= group->mask;
+        merge_duplicate_groups(entry, nearest);
+    }
+}
+
+void init_hit_summary(hit_summary *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+}
+
+/*
+ * Adds a hidden instruction to the summary. with_regs and
+ * with_vector_regs tell whether the result has valid register values.
+ */
+void add_hit(hit_summary *summary, execution_result *result, bool with_regs,
+             bool with_vector_regs)
+{
+    hit_signature sig;
+    compute_signature(result, with_regs, with_vector_regs, &sig);
+
+    ++summary->hits;
+    summary->dirty = true;
+
+    signature_entry *entry = find_signature(summary, &sig);
+    if (entry == NULL) {
+        ++summary->dropped;
+        return;
+    }
+
+    ++entry->count;
+    add_to_groups(entry, result->insn);
+}
+
+static void write_signature(FILE *fp, hit_signature *sig)
+{
+    fprintf(fp, ",%" PRId32, sig->signal);
+    if (sig->timed_out) {
+        fprintf(fp, ",timeout");
+    } else if (sig->signal != 0) {
+        fprintf(fp, ",code:");
+        write_si_code(fp, sig->signal, sig->sig_code);
+    }
+
+    if (sig->pc_delta != 0)
+        fprintf(fp, ",pc:%+lld", (long long)sig->pc_delta);
+
+    if (sig->regs_changed != 0) {
+        fprintf(fp, ",regs:");
+        bool first = true;
+        for (uint32_t i = 0; i < 64; ++i) {
+            if (!(sig->regs_changed & (1ULL << i)))
+                continue;
+            if (!first)
+                fprintf(fp, "|");
+            write_reg_name(fp, i);
+            first = false;
+        }
+    }
+
+    if (sig->vregs_changed != 0) {
+        fprintf(fp, ",vregs:");
+        bool first = true;
+        for (uint32_t i = 0; i < VFPREG_COUNT; ++i) {
+            if (!(sig->vregs_changed & (1U << i)))
+                continue;
+#ifdef __aarch64__
+            fprintf(fp, "%sv%" PRIu32, first ? "" : "|", i);
+#else
+            fprintf(fp, "%sd%" PRIu32, first ? "" : "|", i);
+#endif
+            first = false;
+        }
+    }
+
+    if (sig->fp_status_changed)
+        fprintf(fp, ",fpstatus");
+
+    if (sig->transforms != 0) {
+        fprintf(fp, ",transform:");
+        bool first = true;
+        for (uint32_t i = 0; i < sizeof(TRANSFORM_STR) / sizeof(*TRANSFORM_STR);
+                ++i) {
+            if (!(sig->transforms & (1 << i)))
+                continue;
+            fprintf(fp, "%s%s", first ? "" : "|", TRANSFORM_STR[i]);
+            first = false;
+        }
+    }
+
+    if (sig->wrote_mem)
+        fprintf(fp, ",mem");
+}
+
+// Most frequent signatures first
+static int compare_entries(const void *a, const void *b)
+{
+    const signature_entry *x = *(const signature_entry**)a;
+    const signature_entry *y = *(const signature_entry**)b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return memcmp(&x->sig, &y->sig, sizeof(x->sig));
+}
+
+static int compare_groups(const void *a, const void *b)
+{
+    const hit_group *x = a;
+    const hit_group *y = b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    return x->mask < y->mask ? 1 : x->mask > y->mask ? -1 : 0;
+}
+
+/*
+ * Writes the summary to path, with a line per group:
+ *
+ *   <value>/<mask>,<count>,<signal>[,code:<si_code>|,timeout][,pc:<delta>]
+ *       [,regs:<reg>|...][,vregs:<reg>|...][,fpstatus]
+ *       [,transform:<class>|...][,mem]
+ *
+ * The file is replaced atomically, so that it can be read while the search
+ * is running.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int write_hit_summary(hit_summary *summary, const char *path)
+{
+    static signature_entry *sorted[SUMMARY_MAX_SIGNATURES];
+    uint32_t count = 0;
+    uint32_t group_count = 0;
+    const uint32_t size = sizeof(summary->entries) / sizeof(*summary->entries);
+    for (uint32_t i = 0; i < size; ++i) {
+        if (summary->entries[i].used) {
+            sorted[count++] = &summary->entries[i];
+            group_count += summary->entries[i].group_count;
+        }
+    }
+    qsort(sorted, count, sizeof(*sorted), compare_entries);
+
+    char *tmp_path;
+    if (asprintf(&tmp_path, "%s.tmp", path) == -1)
+        return -1;
+
+    FILE *fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        free(tmp_path);
+        return -1;
+    }
+
+    fprintf(fp, "# summary:hits=%llu,signatures=%" PRIu32 ",groups=%" PRIu32
+                ",dropped=%llu\n",
+            (unsigned long long)summary->hits, count, group_count,
+            (unsigned long long)summary->dropped);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        signature_entry *entry = sorted[i];
+        qsort(entry->groups, entry->group_count, sizeof(*entry->groups),
+              compare_groups);
+        for (uint32_t j = 0; j < entry->group_count; ++j) {
+            fprintf(fp, "%08" PRIx32 "/%08" PRIx32 ",%llu",
+                    entry->groups[j].value, entry->groups[j].mask,
+                    (unsigned long long)entry->groups[j].count);
+            write_signature(fp, &entry->sig);
+            fprintf(fp, "\n");
+        }
+    }
+
+    int ret = 0;
+    if (ferror(fp))
+        ret = -1;
+    if (fclose(fp) != 0)
+        ret = -1;
+    if (ret == 0 && rename(tmp_path, path) == -1)
+        ret = -1;
+    free(tmp_path);
+
+    if (ret == 0)
+        summary->dirty = false;
+    return ret;
+}
+
+void free_hit_summary(hit_summary *summary)
+{
+    const uint32_t size = sizeof(summary->entries) / sizeof(*summary->entries);
+    for (uint32_t i = 0; i < size; ++i)
+        free(summary->entries[i].groups);
+    memset(summary, 0, sizeof(*summary));
+}
@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/*
+ * Opens the timing log (data/timing<suffix>) of --timing. The header
+ * records how the latencies were measured: the source (the virtual counter
+ * or perf cycles), the counter frequency, the runs per encoding and the
+ * baseline (the latency of a nop) subtracted from every run.
+ */
+int open_timing_log(timing_log *log, const char *path, const char *source,
+                    uint64_t frequency, uint32_t runs, uint64_t baseline)
+{
+    memset(log, 0, sizeof(*log));
+    log->baseline = baseline;
+
+    log->fp = fopen(path, "w");
+    if (log->fp == NULL)
+        return -1;
+
+    fprintf(log->fp, "# timing:source=%s,freq=%llu,runs=%u,baseline=%llu\n",
+            source, (unsigned long long)frequency, runs,
+            (unsigned long long)baseline);
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Writes the entry at pos in the window, flagged as slow or fast if its
+ * median is more than twice (or less than half) the median of its
+ * neighbours' medians. The +1 keeps single ticks of a coarse counter from
+ * being flagged.
+ */
+static int write_entry(timing_log *log, uint32_t pos)
+{
+    uint64_t medians[2 * TIMING_NEIGHBOURS];
+    uint32_t count = 0;
+    uint32_t first = pos > TIMING_NEIGHBOURS ? pos - TIMING_NEIGHBOURS : 0;
+    for (uint32_t i = first;
+            i < log->window_count && i <= pos + TIMING_NEIGHBOURS; ++i) {
+        if (i != pos)
+            medians[count++] = log->window[i].median;
+    }
+
+    timing_entry *entry = &log->window[pos];
+    const char *flag = "";
+    if (count > 0) {
+        qsort(medians, count, sizeof(*medians), compare_u64);
+        uint64_t reference = medians[count / 2];
+        if (entry->median > 2 * reference + 1)
+            flag = ",slow";
+        else if (2 * entry->median + 1 < reference)
+            flag = ",fast";
+    }
+
+    ++log->written;
+    if (fprintf(log->fp, "%08" PRIx32 ",%llu,%llu,%llu,%llu,%llu%s\n",
+                entry->insn, (unsigned long long)entry->min,
+                (unsigned long long)entry->q1,
+                (unsigned long long)entry->median,
+                (unsigned long long)entry->q3,
+                (unsigned long long)entry->max, flag) < 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * Adds the runs of an encoding to the log (the samples are sorted in
+ * place). Encodings must be added in the order they were executed, as that
+ * is what makes them neighbours.
+ *
+ * Returns 0 on success and -1 if the log couldn't be written.
+ */
+int add_timing(timing_log *log, uint32_t insn, uint64_t *samples,
+               uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        samples[i] = samples[i] > log->baseline ? samples[i] - log->baseline
+                                                : 0;
+    qsort(samples, count, sizeof(*samples), compare_u64);
+
+    if (log->window_count == TIMING_WINDOW) {
+        memmove(log->window, log->window + 1,
+                (TIMING_WINDOW - 1) * sizeof(timing_entry));
+        --log->window_count;
+    }
+
+    log->window[log->window_count++] = (timing_entry){
+        .insn = insn,
+        .min = samples[0],
+        .q1 = samples[(count - 1) / 4],
+        .median = samples[(count - 1) / 2],
+        .q3 = samples[(count - 1) * 3 / 4],
+        .max = samples[count - 1],
+    };
+    ++log->added;
+
+    if (log->added <= TIMING_NEIGHBOURS)
+        return 0;
+
+    uint64_t window_start = log->added - log->window_count;
+    return write_entry(log, log->written - window_start);
+}
+
+/*
+ * Writes the entries still waiting for their neighbours (which are compared
+ * with the ones before them only), and closes the log.
+ */
+int close_timing_log(timing_log *log)
+{
+    int ret = 0;
+    uint64_t window_start = log->added - log->window_count;
+    while (log->written < log->added) {
+        if (write_entry(log, log->written - window_start) == -1)
+            ret = -1;
+    }
+    if (fclose(log->fp) != 0)
+        ret = -1;
+    log->fp = NULL;
+    return ret;
+}
+
+/*
+ * Returns the frequency of the virtual counter read by the timing
+ * boilerplate, or 0 if the firmware didn't set it (in which case the counter
+ * can't be relied on).
+ */
+uint64_t read_counter_frequency(void)
+{
+    uint64_t frequency;
+#ifdef __aarch64__
+    asm volatile("mrs %0, cntfrq_el0" : "=r" (frequency));
+#else
+    uint32_t cntfrq;
+    asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r" (cntfrq));
+    frequency = cntfrq;
+#endif
+    return frequency;
+}
+
+/*
+ * Opens a cycle counter for the calling thread, counting in user space
+ * only, so that the syscalls reading it hardly add to the measurement.
+ *
+ * Returns the perf fd, or -1 on failure.
+ */
+int open_cycle_counter(void)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CPU_CYCLES,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t read_cycle_counter(int fd)
+{
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    return count;
+}
@@ -1,4 +1,5 @@
 #include "util.h"
+#include <stdio.h>
 
 /*
  * Checks whether the supplied instruction is a 32-bit long
@@ -14,3 +15,64 @@ bool is_thumb32(uint32_t insn)
     uint8_t prefix = (upper >> 11) & 0x1f;
     return prefix >= 0x1d && prefix <= 0x1f;
 }
+
+/*
+ * Reads the MIDR (Main ID Register) of the given CPU, which identifies its
+ * implementer, part (e.g. 0xd03 for Cortex-A53) and revision. The value is
+ * read from sysfs, or assembled from /proc/cpuinfo on kernels without the
+ * sysfs entry (e.g. AArch32 kernels).
+ *
+ * Returns 0 if the MIDR can't be determined.
+ */
+uint64_t read_midr(int cpu)
+{
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/regs/identification/midr_el1",
+             cpu);
+
+    uint64_t midr = 0;
+    FILE *fp = fopen(path, "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%" SCNx64, &midr) != 1)
+            midr = 0;
+        fclose(fp);
+        return midr;
+    }
+
+    fp = fopen("/proc/cpuinfo", "r");
+    if (fp == NULL)
+        return 0;
+
+    char line[256];
+    int curr_cpu = -1;
+    unsigned int implementer = 0, variant = 0, part = 0, revision = 0;
+    bool found = false;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        unsigned int val;
+        if (sscanf(line, "processor : %u", &val) == 1) {
+            if (curr_cpu == cpu)
+                break;
+            curr_cpu = val;
+        } else if (curr_cpu != cpu) {
+            continue;
+        } else if (sscanf(line, "CPU implementer : %x", &val) == 1) {
+            implementer = val;
+            found = true;
+        } else if (sscanf(line, "CPU variant : %x", &val) == 1) {
+            variant = val;
+        } else if (sscanf(line, "CPU part : %x", &val) == 1) {
+            part = val;
+        } else if (sscanf(line, "CPU revision : %u", &val) == 1) {
+            revision = val;
+        }
+    }
+    fclose(fp);
+
+    if (!found)
+        return 0;
+
+    // The architecture field is 0xf (defined by CPUID scheme) on Armv7+
+    return (implementer << 24) | (variant << 20) | (0xf << 16)
+           | (part << 4) | revision;
+}
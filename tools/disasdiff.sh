@@ -0,0 +1,113 @@
+#!/bin/bash
+
+# Classifies every encoding of the range as defined or undefined with two
+# fuzzer builds, e.g. the one with the bundled libopcodes and the one with
+# the installed libopcodes (make fuzzer-shared), and prints the ranges
+# where their verdicts differ. These are the only encodings that need to
+# be executed again after switching to the other libopcodes.
+#
+# Nothing is executed: both builds run with -n and --no-capstone, each
+# split over the given number of workers, and record their libopcodes
+# verdicts (skipped, i.e. defined, or unexecuted, i.e. undefined) in a
+# result map, which are then compared with mapdiff.
+
+usage() {
+    echo "Usage: $(basename "$0") [-s start] [-e end] [-w workers] [-o map]" \
+         "<fuzzer_a> <fuzzer_b> [-- fuzzer options]"
+    exit 1
+}
+
+start=0
+end=ffffffff
+# Per build
+workers=$(( $(nproc) / 2 > 0 ? $(nproc) / 2 : 1 ))
+map=data/disasdiff
+
+while getopts "s:e:w:o:h" opt; do
+    case $opt in
+        s) start=${OPTARG#0x} ;;
+        e) end=${OPTARG#0x} ;;
+        w) workers=$OPTARG ;;
+        o) map=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [[ $# -lt 2 || ! $workers =~ ^[1-9][0-9]*$ ]]; then
+    usage
+fi
+
+fuzzer_a=$1
+fuzzer_b=$2
+shift 2
+if [[ "$1" = "--" ]]; then
+    shift
+fi
+
+mapdiff=$(dirname "$0")/mapdiff
+if [[ ! -x "$mapdiff" ]]; then
+    echo "$mapdiff not found, run make tools"
+    exit 1
+fi
+
+first=$((16#$start))
+last=$((16#$end))
+if (( first > last )); then
+    usage
+fi
+
+# Two encodings share a byte of the map, so the workers get whole pages,
+# starting at page-aligned (and thus even) encodings
+chunk=$(( (last - first + 1) / workers & ~0xfff ))
+if (( chunk == 0 )); then
+    workers=1
+fi
+
+worker_first() {
+    if (( $1 == 0 )); then
+        echo $first
+    else
+        echo $(( (first + chunk * $1) & ~0xfff ))
+    fi
+}
+
+mkdir -p data "$(dirname "$map")"
+
+pids=()
+for build in a b; do
+    if [[ $build = a ]]; then
+        fuzzer=$fuzzer_a
+    else
+        fuzzer=$fuzzer_b
+    fi
+
+    for ((i = 0; i < workers; ++i)); do
+        worker_start=$(worker_first $i)
+        if (( i == workers - 1 )); then
+            worker_end=$last
+        else
+            worker_end=$(( $(worker_first $((i + 1))) - 1 ))
+        fi
+
+        # Capstone would mark encodings it finds defined as skipped too,
+        # hiding the libopcodes verdict in capstone builds
+        "$fuzzer" -n -q --no-capstone -l "disasdiff_$build$i" \
+                  -s "$(printf '%x' $worker_start)" \
+                  -e "$(printf '%x' $worker_end)" \
+                  -M "${map}_$build" "$@" > /dev/null &
+        pids+=($!)
+    done
+done
+
+failed=0
+for pid in "${pids[@]}"; do
+    wait "$pid" || failed=1
+done
+
+if (( failed )); then
+    echo "A fuzzer failed, see above"
+    exit 1
+fi
+
+"$mapdiff" -s "$start" -e "$end" "${map}_a" "${map}_b"
@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+
+# Generates the opcode tables of the SBO/SBZ filter (src/filter.c) from the
+# tables in the bundled libopcodes, and an overlay of the should-be-one/
+# should-be-zero bit masks that libopcodes doesn't know about.
+#
+# The A32/T32 tables are emitted in full and in the same order as in
+# arm-dis.c, since both libopcodes and the filter use the first match.
+# The A64 table isn't ordered like that, so only the instructions in the
+# overlay are emitted, after checking that they're still in aarch64-tbl.h.
+#
+# Overlay entries whose opcode is no longer in the libopcodes tables are
+# an error, so that the masks don't silently go stale when the bundled
+# tables are updated.
+
+from sys import argv, stderr
+from os.path import basename, join
+import re
+
+# Disassembly string macros used in the tables. The disassembly is only
+# there for reference, so these are shortened.
+STRING_MACROS = {
+    'UNDEFINED_INSTRUCTION': 'UNDEFINED',
+    'UNKNOWN_INSTRUCTION_32BIT': 'UNDEFINED',
+    'UNKNOWN_INSTRUCTION_16BIT': 'UNDEFINED',
+    'UNPREDICTABLE_INSTRUCTION': '',
+}
+
+# Filter tables and the arm-dis.c tables they're made of, in the order
+# libopcodes tries them. The iWMMXt instructions in coprocessor_opcodes
+# are skipped, like libopcodes does for ARMv8. The M-profile MVE and CDE
+# tables aren't used for A-profile targets.
+ARM_TABLES = [
+    ('base_opcodes', ['arm_opcodes'], 8),
+    ('coproc_opcodes', ['coprocessor_opcodes', 'neon_opcodes',
+                        'generic_coprocessor_opcodes'], 8),
+    ('thumb16_opcodes', ['thumb_opcodes'], 4),
+    ('thumb32_opcodes', ['thumb32_opcodes'], 8),
+]
+
+
+def error(msg):
+    print('{}: {}'.format(basename(argv[0]), msg), file=stderr)
+    exit(1)
+
+
+def skip_string(src, i):
+    """Returns the index after the string literal starting at src[i]."""
+    i += 1
+    while src[i] != '"':
+        if src[i] == '\\':
+            i += 1
+        i += 1
+    return i + 1
+
+
+def strip_comments(src):
+    out = []
+    i = 0
+    while i < len(src):
+        if src[i] == '"':
+            end = skip_string(src, i)
+            out.append(src[i:end])
+            i = end
+        elif src.startswith('/*', i):
+            i = src.index('*/', i) + 2
+            out.append(' ')
+        else:
+            out.append(src[i])
+            i += 1
+    return ''.join(out)
+
+
+def table_entries(src, name):
+    """Returns the brace-enclosed entries of a table, as strings."""
+    res = re.search(r'\b' + name + r'\[\]\s*=\s*\{', src)
+    if res is None:
+        error('table {} not found'.format(name))
+
+    entries = []
+    depth = 1
+    start = None
+    i = res.end()
+    while depth > 0:
+        if src[i] == '"':
+            i = skip_string(src, i)
+            continue
+        if src[i] == '{':
+            if depth == 1:
+                start = i + 1
+            depth += 1
+        elif src[i] == '}':
+            depth -= 1
+            if depth == 1:
+                entries.append(src[start:i])
+        i += 1
+    return entries
+
+
+def split_fields(entry):
+    """Splits an entry on its top-level commas."""
+    fields = []
+    depth = 0
+    start = 0
+    i = 0
+    while i < len(entry):
+        if entry[i] == '"':
+            i = skip_string(entry, i)
+            continue
+        if entry[i] == '(':
+            depth += 1
+        elif entry[i] == ')':
+            depth -= 1
+        elif entry[i] == ',' and depth == 0:
+            fields.append(entry[start:i].strip())
+            start = i + 1
+        i += 1
+    fields.append(entry[start:].strip())
+    return fields
+
+
+def parse_string(field):
+    """Concatenates the literals and known macros of a string field."""
+    parts = re.findall(r'"((?:[^"\\]|\\.)*)"|(\w+)', field)
+    res = ''
+    for literal, macro in parts:
+        if macro:
+            if macro not in STRING_MACROS:
+                return None
+            res += STRING_MACROS[macro]
+        else:
+            res += literal
+    return res
+
+
+def parse_arm_table(src, name):
+    """
+    Returns the (value, mask, disassembly) of the instructions in an
+    arm-dis.c table, with the value and mask being the two fields before
+    the disassembly string.
+    """
+    res = []
+    iwmmxt = False
+    for entry in table_entries(src, name):
+        fields = split_fields(entry)
+        if len(fields) < 3:
+            error('unexpected entry in {}: {}'.format(name, entry))
+
+        if 'SENTINEL_IWMMXT_START' in fields:
+            iwmmxt = True
+            continue
+        if 'SENTINEL_IWMMXT_END' in fields:
+            iwmmxt = False
+            continue
+        if any(f.startswith('SENTINEL_') for f in fields):
+            continue
+        # The terminating entry has no disassembly string
+        if fields[-1] == '0':
+            break
+        if iwmmxt:
+            continue
+
+        disassembly = parse_string(fields[-1])
+        try:
+            value = int(fields[-3], 0)
+            mask = int(fields[-2], 0)
+        except ValueError:
+            disassembly = None
+        if disassembly is None:
+            error('unexpected entry in {}: {}'.format(name, entry))
+        res.append((value, mask, disassembly))
+    return res
+
+
+def parse_a64_table(src):
+    """Returns the (name, value, mask) of the instructions in aarch64-tbl.h."""
+    entries = re.findall(r'\b\w+\s*\(\s*"([\w.]+)"\s*,\s*(0x[0-9a-fA-F]+)'
+                         r'\s*,\s*(0x[0-9a-fA-F]+)', src)
+    return [(name, int(value, 16), int(mask, 16))
+            for name, value, mask in entries]
+
+
+def parse_overlay(path):
+    """
+    Returns the overlay entries as a table name to list of
+    (value, mask, sb_mask, name, line number) mapping.
+    """
+    overlay = {}
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) != 5:
+                error('{}:{}: expected "table value mask sb_mask name"'
+                      .format(path, lineno))
+            try:
+                value, mask, sb_mask = (int(x, 16) for x in fields[1:4])
+            except ValueError:
+                error('{}:{}: invalid hex number'.format(path, lineno))
+            overlay.setdefault(fields[0], []).append(
+                (value, mask, sb_mask, fields[4], lineno))
+    return overlay
+
+
+def format_table(name, entries, digits):
+    lines = ['static const struct opcode {}[] ='.format(name), '{']
+    for value, mask, sb_mask, disassembly in entries:
+        lines.append('    {{0x{:0{w}x}, 0x{:0{w}x}, {}, "{}"}},'.format(
+            value, mask, '0x{:0{w}x}'.format(sb_mask, w=digits) if sb_mask else '0',
+            disassembly, w=digits))
+    lines.append('    {{0x{:0{w}x}, 0x{:0{w}x}, 0, 0}}'.format(0, 0, w=digits))
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def main():
+    if len(argv) != 4:
+        print('Usage: {} <opcodes dir> <overlay> <output header>'
+              .format(basename(argv[0])))
+        exit(1)
+
+    opcodes_dir, overlay_path, out_path = argv[1:]
+    with open(join(opcodes_dir, 'arm-dis.c')) as f:
+        arm_src = strip_comments(f.read())
+    with open(join(opcodes_dir, 'aarch64-tbl.h')) as f:
+        a64_src = strip_comments(f.read())
+    overlay = parse_overlay(overlay_path)
+
+    tables = []
+
+    a64_insns = set(parse_a64_table(a64_src))
+    a64_entries = []
+    for value, mask, sb_mask, name, lineno in overlay.pop('aarch64', []):
+        if (name, value, mask) not in a64_insns:
+            error('{}:{}: {} not found in aarch64-tbl.h'
+                  .format(overlay_path, lineno, name))
+        a64_entries.append((value, mask, sb_mask, name))
+    tables.append(format_table('a64_opcodes', a64_entries, 8))
+
+    for filter_table, arm_tables, digits in ARM_TABLES:
+        entries = []
+        for arm_table in arm_tables:
+            insns = parse_arm_table(arm_src, arm_table)
+            sb_masks = {}
+            for value, mask, sb_mask, name, lineno in \
+                    overlay.pop(arm_table, []):
+                if not any(v == value and m == mask for v, m, _ in insns):
+                    error('{}:{}: {} not found in {}'
+                          .format(overlay_path, lineno, name, arm_table))
+                sb_masks[(value, mask)] = sb_mask
+            entries += [(value, mask, sb_masks.get((value, mask), 0), dis)
+                        for value, mask, dis in insns]
+        tables.append(format_table(filter_table, entries, digits))
+
+    for table in overlay:
+        error('{}: unknown table {}'.format(overlay_path, table))
+
+    with open(out_path, 'w') as f:
+        f.write('/*\n'
+                ' * Generated by tools/gen_filter.py from the libopcodes\n'
+                ' * opcode tables and {}. Do not edit.\n'
+                ' */\n\n'.format(basename(overlay_path)))
+        f.write('\n\n'.join(tables))
+        f.write('\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,635 @@
+/*
+ * Renders where in the instruction space the results of a search lie, as
+ * an image in which every pixel aggregates a block of encodings, laid out
+ * along a Hilbert curve (so that neighbouring ranges stay close together)
+ * or row by row. Given two result maps, it renders where they differ.
+ *
+ * Usage: heatmap [-s start] [-e end] [-w width] [-l layout] -o <image>
+ *                <map_or_log> [<map_b>]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "resmap.h"
+
+// Bytes read from a result map at a time (each byte holds two entries)
+#define CHUNK_SIZE (1 << 22)
+
+// Maximum bytes of a stored (uncompressed) deflate block
+#define PNG_STORED_BLOCK 65535
+
+typedef struct {
+    uint8_t r, g, b;
+} rgb;
+
+static const rgb CLASS_COLOURS[RESULT_CLASS_COUNT] = {
+    [RESULT_UNVISITED]    = {0x00, 0x00, 0x00},
+    [RESULT_SKIPPED]      = {0x60, 0x60, 0x60},
+    [RESULT_FILTERED]     = {0x20, 0x40, 0xa0},
+    [RESULT_UNEXECUTED]   = {0x40, 0x40, 0x40},
+    [RESULT_SIGILL]       = {0x10, 0x50, 0x20},
+    [RESULT_SIGSEGV]      = {0xff, 0x80, 0x00},
+    [RESULT_SIGTRAP]      = {0xff, 0xff, 0x00},
+    [RESULT_SIGBUS]       = {0xff, 0x00, 0xff},
+    [RESULT_NO_SIGNAL]    = {0xff, 0x00, 0x00},
+    [RESULT_OTHER_SIGNAL] = {0xff, 0x80, 0xc0},
+    [RESULT_TIMEOUT]      = {0xff, 0xff, 0xff},
+    [RESULT_SYSCALL]      = {0x00, 0xff, 0xff},
+};
+
+static const rgb DIFF_COLOUR = {0xff, 0x00, 0x00};
+
+typedef enum {
+    LAYOUT_HILBERT,
+    LAYOUT_LINEAR
+} layout;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    // Encodings per pixel, as a power of two
+    uint32_t block_shift;
+    uint32_t width;
+    // Per pixel and class
+    uint32_t *counts;
+    // Per pixel, encodings that differ between the maps
+    uint32_t *diffs;
+    uint64_t class_totals[RESULT_CLASS_COUNT];
+    uint64_t diff_total;
+} heatmap;
+
+static bool is_hit(result_class class)
+{
+    return class >= RESULT_SIGSEGV && class < RESULT_CLASS_COUNT;
+}
+
+static void add_result(heatmap *map, uint32_t insn, result_class class)
+{
+    if (class >= RESULT_CLASS_COUNT)
+        return;
+    uint64_t pixel = (uint64_t)(insn - map->start) >> map->block_shift;
+    ++map->counts[pixel * RESULT_CLASS_COUNT + class];
+    ++map->class_totals[class];
+}
+
+static void add_diff(heatmap *map, uint32_t insn)
+{
+    uint64_t pixel = (uint64_t)(insn - map->start) >> map->block_shift;
+    ++map->diffs[pixel];
+    ++map->diff_total;
+}
+
+static int open_map(const char *path, result_map_header *header)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+
+    if (read_result_map_header(fd, header) != 0) {
+        close(fd);
+        return -2;
+    }
+    return fd;
+}
+
+/*
+ * Returns the offset of the next byte at or after offset that isn't in a
+ * hole, or UINT64_MAX if there is none.
+ */
+static uint64_t next_data(int fd, uint64_t offset)
+{
+    off_t data = lseek(fd, offset, SEEK_DATA);
+    if (data == -1)
+        return errno == ENXIO ? UINT64_MAX : offset;
+    return data;
+}
+
+/*
+ * Streams over one result map, or two (fd_b != -1) to record where they
+ * differ, a chunk at a time. The classes are taken from the first map.
+ */
+static int read_maps(heatmap *map, int fd_a, int fd_b)
+{
+    uint8_t *buf_a = malloc(CHUNK_SIZE);
+    uint8_t *buf_b = malloc(CHUNK_SIZE);
+    if (buf_a == NULL || buf_b == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate buffers\n");
+        return -1;
+    }
+    memset(buf_b, 0, CHUNK_SIZE);
+
+    uint64_t first_byte = map->start / 2;
+    uint64_t last_byte = map->end / 2;
+    for (uint64_t chunk = first_byte; chunk <= last_byte; ) {
+        // Slices that were never written are holes in both maps
+        uint64_t data = next_data(fd_a, RESULT_MAP_HEADER_SIZE + chunk);
+        if (fd_b != -1) {
+            uint64_t data_b = next_data(fd_b, RESULT_MAP_HEADER_SIZE + chunk);
+            data = data_b < data ? data_b : data;
+        }
+        if (data == UINT64_MAX)
+            break;
+        if (data > RESULT_MAP_HEADER_SIZE + chunk) {
+            chunk = data - RESULT_MAP_HEADER_SIZE;
+            continue;
+        }
+
+        size_t length = CHUNK_SIZE;
+        if (chunk + length > last_byte + 1)
+            length = last_byte + 1 - chunk;
+
+        off_t offset = RESULT_MAP_HEADER_SIZE + chunk;
+        if (pread(fd_a, buf_a, length, offset) != (ssize_t)length
+                || (fd_b != -1
+                    && pread(fd_b, buf_b, length, offset) != (ssize_t)length)) {
+            fprintf(stderr, "ERROR: Unable to read maps\n");
+            return -1;
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+            if (buf_a[i] == 0 && buf_b[i] == 0)
+                continue;
+
+            for (uint32_t half = 0; half < 2; ++half) {
+                uint32_t insn = (uint32_t)((chunk + i) * 2 + half);
+                if (insn < map->start || insn > map->end)
+                    continue;
+
+                result_class class_a = (buf_a[i] >> (half * 4)) & 0xf;
+                result_class class_b = (buf_b[i] >> (half * 4)) & 0xf;
+                if (class_a != RESULT_UNVISITED)
+                    add_result(map, insn, class_a);
+                if (fd_b != -1 && class_a != class_b)
+                    add_diff(map, insn);
+            }
+        }
+        chunk += length;
+    }
+
+    free(buf_a);
+    free(buf_b);
+    return 0;
+}
+
+/*
+ * Reads the hits from a fuzzer log. Everything else is unknown, and left
+ * unvisited.
+ */
+static int read_log(heatmap *map, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, fp) != -1) {
+        if (line[0] == '#')
+            continue;
+
+        char *kind;
+        unsigned long insn = strtoul(line, &kind, 16);
+        if (*kind != ',' || insn < map->start || insn > map->end)
+            continue;
+        ++kind;
+
+        if (strncmp(kind, "hidden,", 7) == 0)
+            add_result(map, insn, result_class_from_signal(atoi(kind + 7)));
+        else if (strncmp(kind, "timeout,", 8) == 0)
+            add_result(map, insn, RESULT_TIMEOUT);
+        else if (strncmp(kind, "syscall,", 8) == 0)
+            add_result(map, insn, RESULT_SYSCALL);
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+// Maps a distance along the Hilbert curve to coordinates in a square
+static void hilbert_to_xy(uint32_t side, uint64_t d, uint32_t *x, uint32_t *y)
+{
+    *x = 0;
+    *y = 0;
+    for (uint32_t s = 1; s < side; s *= 2) {
+        uint32_t rx = 1 & (d / 2);
+        uint32_t ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                *x = s - 1 - *x;
+                *y = s - 1 - *y;
+            }
+            uint32_t tmp = *x;
+            *x = *y;
+            *y = tmp;
+        }
+        *x += s * rx;
+        *y += s * ry;
+        d /= 4;
+    }
+}
+
+/*
+ * Picks the colour of a block of encodings. A block with hits is shown in
+ * the (mixed) colours of its hits, however few there are, as they are
+ * what the search is for, with their density as the brightness. Other
+ * blocks mix the colours of all their classes.
+ */
+static rgb pixel_colour(uint32_t *counts)
+{
+    uint64_t hits = 0;
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < RESULT_CLASS_COUNT; ++c) {
+        total += counts[c];
+        if (is_hit(c))
+            hits += counts[c];
+    }
+    if (total == 0)
+        return CLASS_COLOURS[RESULT_UNVISITED];
+
+    uint64_t sum[3] = {0};
+    uint64_t weight = hits > 0 ? hits : total;
+    for (uint32_t c = 0; c < RESULT_CLASS_COUNT; ++c) {
+        if (hits > 0 && !is_hit(c))
+            continue;
+        sum[0] += (uint64_t)counts[c] * CLASS_COLOURS[c].r;
+        sum[1] += (uint64_t)counts[c] * CLASS_COLOURS[c].g;
+        sum[2] += (uint64_t)counts[c] * CLASS_COLOURS[c].b;
+    }
+
+    // Half brightness for a single hit, full brightness for only hits
+    uint64_t scale = hits > 0 ? 128 + 128 * hits / total : 256;
+    return (rgb){
+        .r = sum[0] / weight * scale / 256,
+        .g = sum[1] / weight * scale / 256,
+        .b = sum[2] / weight * scale / 256,
+    };
+}
+
+/*
+ * In diff mode, the first map is shown dimmed, and the blocks where the
+ * maps differ in red, with the share of differing encodings as the
+ * brightness.
+ */
+static rgb diff_colour(uint32_t *counts, uint32_t diffs, uint64_t block_size)
+{
+    if (diffs > 0) {
+        uint64_t scale = 128 + 128 * diffs / block_size;
+        return (rgb){
+            .r = DIFF_COLOUR.r * scale / 256,
+            .g = DIFF_COLOUR.g * scale / 256,
+            .b = DIFF_COLOUR.b * scale / 256,
+        };
+    }
+
+    rgb colour = pixel_colour(counts);
+    colour.r /= 4;
+    colour.g /= 4;
+    colour.b /= 4;
+    return colour;
+}
+
+static void render(heatmap *map, layout layout, uint8_t *pixels)
+{
+    uint64_t pixel_count = ((uint64_t)(map->end - map->start) >> map->block_shift)
+                           + 1;
+    for (uint64_t i = 0; i < pixel_count; ++i) {
+        uint32_t x, y;
+        if (layout == LAYOUT_HILBERT) {
+            hilbert_to_xy(map->width, i, &x, &y);
+        } else {
+            x = i % map->width;
+            y = i / map->width;
+        }
+
+        uint32_t *counts = &map->counts[i * RESULT_CLASS_COUNT];
+        rgb colour = map->diffs != NULL
+            ? diff_colour(counts, map->diffs[i], 1ULL << map->block_shift)
+            : pixel_colour(counts);
+
+        uint8_t *pixel = &pixels[((uint64_t)y * map->width + x) * 3];
+        pixel[0] = colour.r;
+        pixel[1] = colour.g;
+        pixel[2] = colour.b;
+    }
+}
+
+static int write_ppm(FILE *fp, uint8_t *pixels, uint32_t width)
+{
+    fprintf(fp, "P6\n%" PRIu32 " %" PRIu32 "\n255\n", width, width);
+    size_t length = (size_t)width * width * 3;
+    return fwrite(pixels, 1, length, fp) == length ? 0 : -1;
+}
+
+static uint32_t crc_table[256];
+
+static void init_crc_table(void)
+{
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (uint32_t k = 0; k < 8; ++k)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t *buf, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        crc = crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void put_be32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+static void write_chunk(FILE *fp, const char *type, const uint8_t *data,
+                        uint32_t length)
+{
+    uint8_t header[8];
+    put_be32(header, length);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, fp);
+    fwrite(data, 1, length, fp);
+
+    uint32_t crc = update_crc(0xffffffff, header + 4, 4);
+    crc = update_crc(crc, data, length) ^ 0xffffffff;
+    uint8_t crc_bytes[4];
+    put_be32(crc_bytes, crc);
+    fwrite(crc_bytes, 1, 4, fp);
+}
+
+/*
+ * Writes a PNG without a compression library, with the image data in
+ * stored (uncompressed) deflate blocks. The image is mostly large areas
+ * of the same colour, so external tools compress it well if needed.
+ */
+static int write_png(FILE *fp, uint8_t *pixels, uint32_t width)
+{
+    static const uint8_t signature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    fwrite(signature, 1, sizeof(signature), fp);
+    init_crc_table();
+
+    // 8-bit RGB, no interlacing
+    uint8_t ihdr[13] = {0};
+    put_be32(ihdr, width);
+    put_be32(ihdr + 4, width);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    write_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+
+    // Every row is prefixed with its filter type (0, none)
+    size_t row_length = (size_t)width * 3 + 1;
+    size_t raw_length = row_length * width;
+    uint8_t *raw = malloc(raw_length);
+    size_t block_count = (raw_length + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK;
+    size_t zlib_length = 2 + raw_length + block_count * 5 + 4;
+    uint8_t *zlib = malloc(zlib_length);
+    if (raw == NULL || zlib == NULL) {
+        free(raw);
+        free(zlib);
+        return -1;
+    }
+
+    for (uint32_t y = 0; y < width; ++y) {
+        raw[y * row_length] = 0;
+        memcpy(&raw[y * row_length + 1], &pixels[(size_t)y * width * 3],
+               (size_t)width * 3);
+    }
+
+    uint8_t *out = zlib;
+    // Deflate with a 32K window, no preset dictionary
+    *out++ = 0x78;
+    *out++ = 0x01;
+    uint32_t adler_a = 1, adler_b = 0;
+    for (size_t offset = 0; offset < raw_length; offset += PNG_STORED_BLOCK) {
+        size_t length = raw_length - offset < PNG_STORED_BLOCK
+                        ? raw_length - offset : PNG_STORED_BLOCK;
+        *out++ = offset + length == raw_length ? 1 : 0;
+        *out++ = length & 0xff;
+        *out++ = length >> 8;
+        *out++ = ~length & 0xff;
+        *out++ = (~length >> 8) & 0xff;
+        memcpy(out, raw + offset, length);
+        out += length;
+
+        for (size_t i = offset; i < offset + length; ++i) {
+            adler_a = (adler_a + raw[i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+    put_be32(out, adler_b << 16 | adler_a);
+
+    write_chunk(fp, "IDAT", zlib, zlib_length);
+    write_chunk(fp, "IEND", NULL, 0);
+
+    free(raw);
+    free(zlib);
+    return ferror(fp) ? -1 : 0;
+}
+
+static void print_help(char *cmd_name)
+{
+    printf("Usage: %s [option(s)] -o <image> <map_or_log> [<map_b>]\n",
+           cmd_name);
+    printf("\n\
+Renders the results of a search as an image, in which every pixel is a\n\
+block of encodings, coloured by their result classes. Blocks with hidden\n\
+instructions are coloured by the hits alone, so that single hits stand\n\
+out. Given two result maps, the blocks where they differ are shown in\n\
+red, over the first map dimmed. A log only provides the hits.\n\
+\n\
+The image is written as PNG if its name ends in .png, and as PPM\n\
+otherwise.\n\
+\n\
+Colours:\n\
+    black    unvisited            orange   SIGSEGV\n\
+    grey     skipped              yellow   SIGTRAP\n\
+    blue     filtered             magenta  SIGBUS\n\
+    dark     not executed (-n)    red      no signal\n\
+    green    SIGILL               pink     other signals\n\
+                                  white    timeout\n\
+                                  cyan     syscall\n\
+\n\
+Options:\n\
+    -h, --help              Print help information.\n\
+    -s, --start <insn>      Start of the range (in hex).\n\
+    -e, --end <insn>        End of the range, inclusive (in hex).\n\
+    -w, --width <pixels>    Width and height of the image, a power of two.\n\
+                            [default: 1024]\n\
+    -l, --layout <layout>   hilbert: The blocks follow a Hilbert curve, so\n\
+                            neighbouring ranges stay close together.\n\
+                            linear: Row by row, so the upper bits of the\n\
+                            encoding select the row. [default: hilbert]\n\
+    -o, --output <image>    Image file to write.\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    heatmap map = {
+        .start = 0x00000000,
+        .end = 0xffffffff,
+        .width = 1024,
+    };
+    layout layout = LAYOUT_HILBERT;
+    char *output_path = NULL;
+
+    struct option long_options[] = {
+        {"help",    no_argument,        NULL, 'h'},
+        {"start",   required_argument,  NULL, 's'},
+        {"end",     required_argument,  NULL, 'e'},
+        {"width",   required_argument,  NULL, 'w'},
+        {"layout",  required_argument,  NULL, 'l'},
+        {"output",  required_argument,  NULL, 'o'},
+        {NULL,      0,                  NULL, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hs:e:w:l:o:", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+            case 's':
+                map.start = strtoul(optarg, NULL, 16);
+                break;
+            case 'e':
+                map.end = strtoul(optarg, NULL, 16);
+                break;
+            case 'w':
+                map.width = strtoul(optarg, NULL, 10);
+                if (map.width < 16 || map.width > 16384
+                        || (map.width & (map.width - 1)) != 0) {
+                    fprintf(stderr, "ERROR: The width must be a power of two "
+                                    "between 16 and 16384\n");
+                    return 1;
+                }
+                break;
+            case 'l':
+                if (strcmp(optarg, "hilbert") == 0) {
+                    layout = LAYOUT_HILBERT;
+                } else if (strcmp(optarg, "linear") == 0) {
+                    layout = LAYOUT_LINEAR;
+                } else {
+                    fprintf(stderr, "ERROR: Unknown layout %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'h':
+            default:
+                print_help(argv[0]);
+                return 1;
+        }
+    }
+
+    int inputs = argc - optind;
+    if (inputs < 1 || inputs > 2 || output_path == NULL
+            || map.end < map.start) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    // The smallest power-of-two block that fits the range in the image
+    uint64_t range_length = (uint64_t)map.end - map.start + 1;
+    uint64_t pixel_count = (uint64_t)map.width * map.width;
+    while ((pixel_count << map.block_shift) < range_length)
+        ++map.block_shift;
+    pixel_count = ((range_length - 1) >> map.block_shift) + 1;
+
+    map.counts = calloc(pixel_count * RESULT_CLASS_COUNT,
+                        sizeof(*map.counts));
+    if (map.counts == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate the heatmap\n");
+        return 1;
+    }
+
+    result_map_header header_a, header_b;
+    int fd_a = open_map(argv[optind], &header_a);
+    if (fd_a == -1)
+        return 1;
+
+    int ret;
+    if (inputs == 2) {
+        int fd_b = open_map(argv[optind + 1], &header_b);
+        if (fd_a == -2 || fd_b < 0) {
+            fprintf(stderr, "ERROR: Comparing needs two valid result maps\n");
+            return 1;
+        }
+        if (header_a.isa != header_b.isa)
+            fprintf(stderr, "WARNING: The maps are from different ISAs\n");
+
+        map.diffs = calloc(pixel_count, sizeof(*map.diffs));
+        if (map.diffs == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate the heatmap\n");
+            return 1;
+        }
+        ret = read_maps(&map, fd_a, fd_b);
+        close(fd_b);
+    } else if (fd_a == -2) {
+        ret = read_log(&map, argv[optind]);
+    } else {
+        ret = read_maps(&map, fd_a, -1);
+    }
+    if (fd_a >= 0)
+        close(fd_a);
+    if (ret == -1)
+        return 1;
+
+    uint8_t *pixels = calloc(map.width * map.width, 3);
+    if (pixels == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate the image\n");
+        return 1;
+    }
+    render(&map, layout, pixels);
+
+    FILE *fp = fopen(output_path, "wb");
+    if (fp == NULL) {
+        perror(output_path);
+        return 1;
+    }
+    size_t path_length = strlen(output_path);
+    bool png = path_length >= 4
+               && strcmp(output_path + path_length - 4, ".png") == 0;
+    ret = png ? write_png(fp, pixels, map.width)
+              : write_ppm(fp, pixels, map.width);
+    if (fclose(fp) != 0 || ret == -1) {
+        fprintf(stderr, "ERROR: Unable to write %s\n", output_path);
+        return 1;
+    }
+
+    fprintf(stderr, "%" PRIu32 "x%" PRIu32 " pixels of %llu encodings\n",
+            map.width, map.width, 1ULL << map.block_shift);
+    for (uint32_t i = 0; i < RESULT_CLASS_COUNT; ++i) {
+        if (map.class_totals[i] != 0)
+            fprintf(stderr, "    %-10s %" PRIu64 "\n", result_class_name(i),
+                    map.class_totals[i]);
+    }
+    if (map.diffs != NULL)
+        fprintf(stderr, "differences: %" PRIu64 "\n", map.diff_total);
+
+    free(pixels);
+    free(map.counts);
+    free(map.diffs);
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Compares two result maps (as written by the fuzzer's -M option), e.g.
+ * from two different CPUs or QEMU and hardware, and prints every range of
+ * encodings where the results differ.
+ *
+ * Usage: mapdiff [-s start] [-e end] [-q] <map_a> <map_b>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "resmap.h"
+
+// Bytes compared per read (each byte holds two entries)
+#define CHUNK_SIZE (1 << 22)
+
+// Bytes compared as one block before looking at the individual entries
+#define BLOCK_SIZE 64
+
+typedef struct {
+    bool active;
+    uint32_t start;
+    uint32_t end;
+    result_class class_a;
+    result_class class_b;
+} diff_run;
+
+static uint64_t pair_counts[RESULT_CLASS_COUNT + 1][RESULT_CLASS_COUNT + 1];
+
+static void print_run(diff_run *run, bool quiet)
+{
+    if (!run->active || quiet)
+        return;
+
+    printf("%08" PRIx32 "-%08" PRIx32 ",%s,%s\n",
+           run->start, run->end,
+           result_class_name(run->class_a),
+           result_class_name(run->class_b));
+}
+
+static void add_diff(diff_run *run, uint32_t insn, result_class class_a,
+                     result_class class_b, bool quiet)
+{
+    pair_counts[class_a < RESULT_CLASS_COUNT ? class_a : RESULT_CLASS_COUNT]
+               [class_b < RESULT_CLASS_COUNT ? class_b : RESULT_CLASS_COUNT]++;
+
+    if (run->active
+            && run->end + 1 == insn
+            && run->class_a == class_a
+            && run->class_b == class_b) {
+        run->end = insn;
+        return;
+    }
+
+    print_run(run, quiet);
+    run->active = true;
+    run->start = insn;
+    run->end = insn;
+    run->class_a = class_a;
+    run->class_b = class_b;
+}
+
+/*
+ * Returns whether the two blocks are identical. Written as a branch-free
+ * reduction over whole words so that the compiler vectorises it.
+ */
+static bool blocks_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t words_a[BLOCK_SIZE / 8];
+    uint64_t words_b[BLOCK_SIZE / 8];
+    memcpy(words_a, a, BLOCK_SIZE);
+    memcpy(words_b, b, BLOCK_SIZE);
+
+    uint64_t diff = 0;
+    for (uint32_t i = 0; i < BLOCK_SIZE / 8; ++i)
+        diff |= words_a[i] ^ words_b[i];
+    return diff == 0;
+}
+
+/*
+ * Returns the offset of the next byte at or after offset that isn't in a
+ * hole. Slices that were never written are holes in both maps, and can be
+ * skipped without reading them.
+ */
+static uint64_t next_data(int fd, uint64_t offset)
+{
+    off_t data = lseek(fd, offset, SEEK_DATA);
+    if (data == -1)
+        return errno == ENXIO ? UINT64_MAX : offset;
+    return data;
+}
+
+static int open_map(const char *path, result_map_header *header)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+
+    if (read_result_map_header(fd, header) != 0) {
+        fprintf(stderr, "ERROR: %s is not a valid result map\n", path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_help(char *cmd_name)
+{
+    printf("Usage: %s [option(s)] <map_a> <map_b>\n", cmd_name);
+    printf("\n\
+Prints the encoding ranges where two result maps differ, in the format\n\
+<start>-<end>,<result_a>,<result_b>, followed by a summary.\n\
+\n\
+Options:\n\
+    -h, --help              Print help information.\n\
+    -s, --start <insn>      Start of compared range (in hex).\n\
+    -e, --end <insn>        End of compared range, inclusive (in hex).\n\
+    -q, --quiet             Only print the summary.\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t range_start = 0x00000000;
+    uint32_t range_end = 0xffffffff;
+    bool quiet = false;
+
+    struct option long_options[] = {
+        {"help",    no_argument,        NULL, 'h'},
+        {"start",   required_argument,  NULL, 's'},
+        {"end",     required_argument,  NULL, 'e'},
+        {"quiet",   no_argument,        NULL, 'q'},
+        {NULL,      0,                  NULL, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hs:e:q", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                range_start = strtoul(optarg, NULL, 16);
+                break;
+            case 'e':
+                range_end = strtoul(optarg, NULL, 16);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'h':
+            default:
+                print_help(argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind != 2 || range_end < range_start) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    result_map_header header_a, header_b;
+    int fd_a = open_map(argv[optind], &header_a);
+    int fd_b = open_map(argv[optind + 1], &header_b);
+    if (fd_a == -1 || fd_b == -1)
+        return 1;
+
+    if (header_a.isa != header_b.isa)
+        fprintf(stderr, "WARNING: The maps are from different ISAs\n");
+
+    uint8_t *buf_a = malloc(CHUNK_SIZE);
+    uint8_t *buf_b = malloc(CHUNK_SIZE);
+    if (buf_a == NULL || buf_b == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate buffers\n");
+        return 1;
+    }
+
+    diff_run run = {0};
+    uint64_t diff_count = 0;
+    uint64_t first_byte = range_start / 2;
+    uint64_t last_byte = range_end / 2;
+
+    uint64_t chunk = first_byte;
+    while (chunk <= last_byte) {
+        uint64_t data_a = next_data(fd_a, RESULT_MAP_HEADER_SIZE + chunk);
+        uint64_t data_b = next_data(fd_b, RESULT_MAP_HEADER_SIZE + chunk);
+        uint64_t data = data_a < data_b ? data_a : data_b;
+        if (data > RESULT_MAP_HEADER_SIZE + chunk) {
+            if (data == UINT64_MAX)
+                break;
+            chunk = data - RESULT_MAP_HEADER_SIZE;
+            continue;
+        }
+
+        size_t length = CHUNK_SIZE;
+        if (chunk + length > last_byte + 1)
+            length = last_byte + 1 - chunk;
+
+        off_t offset = RESULT_MAP_HEADER_SIZE + chunk;
+        if (pread(fd_a, buf_a, length, offset) != (ssize_t)length
+                || pread(fd_b, buf_b, length, offset) != (ssize_t)length) {
+            fprintf(stderr, "ERROR: Unable to read maps\n");
+            return 1;
+        }
+
+        for (size_t block = 0; block < length; block += BLOCK_SIZE) {
+            size_t block_length = length - block < BLOCK_SIZE
+                                  ? length - block : BLOCK_SIZE;
+
+            if (block_length == BLOCK_SIZE
+                    && blocks_equal(buf_a + block, buf_b + block))
+                continue;
+
+            for (size_t i = block; i < block + block_length; ++i) {
+                if (buf_a[i] == buf_b[i])
+                    continue;
+
+                for (uint32_t half = 0; half < 2; ++half) {
+                    uint32_t insn = (uint32_t)((chunk + i) * 2 + half);
+                    result_class class_a = (buf_a[i] >> (half * 4)) & 0xf;
+                    result_class class_b = (buf_b[i] >> (half * 4)) & 0xf;
+
+                    if (class_a == class_b
+                            || insn < range_start || insn > range_end)
+                        continue;
+
+                    add_diff(&run, insn, class_a, class_b, quiet);
+                    ++diff_count;
+                }
+            }
+        }
+        chunk += length;
+    }
+    print_run(&run, quiet);
+
+    fprintf(stderr, "differences: %" PRIu64 "\n", diff_count);
+    for (uint32_t a = 0; a <= RESULT_CLASS_COUNT; ++a) {
+        for (uint32_t b = 0; b <= RESULT_CLASS_COUNT; ++b) {
+            if (pair_counts[a][b] != 0)
+                fprintf(stderr, "    %-10s -> %-10s %" PRIu64 "\n",
+                        result_class_name(a), result_class_name(b),
+                        pair_counts[a][b]);
+        }
+    }
+
+    free(buf_a);
+    free(buf_b);
+    close(fd_a);
+    close(fd_b);
+
+    return diff_count == 0 ? 0 : 2;
+}
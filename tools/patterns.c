@@ -0,0 +1,398 @@
+/*
+ * Infers the encoding patterns of hidden instructions: reads the hits from
+ * fuzzer logs and/or result maps (as written by the fuzzer's -M option),
+ * and greedily builds a small set of (value, mask) patterns that cover
+ * them, printed as -s/-m options for targeted runs.
+ *
+ * Usage: patterns [-s start] [-e end] [-x] <log_or_map>...
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "resmap.h"
+
+// Bytes read from a result map at a time (each byte holds two entries)
+#define CHUNK_SIZE (1 << 22)
+
+/*
+ * A bit per encoding of the searched range. Bit 0 of words[0] is the
+ * encoding base, which is the range start rounded down to a whole word.
+ */
+typedef struct {
+    uint64_t *words;
+    uint64_t base;
+    uint64_t word_count;
+} bitset;
+
+typedef enum {
+    SCAN_ANY,
+    SCAN_ALL,
+    SCAN_COUNT,
+    SCAN_CLEAR
+} scan_op;
+
+static int init_bitset(bitset *set, uint32_t start, uint32_t end)
+{
+    set->base = start & ~63ULL;
+    set->word_count = ((end - set->base) >> 6) + 1;
+    // Untouched parts of the range don't take up memory
+    set->words = calloc(set->word_count, sizeof(*set->words));
+    return set->words == NULL ? -1 : 0;
+}
+
+static void set_bit(bitset *set, uint32_t insn)
+{
+    uint64_t i = insn - set->base;
+    set->words[i >> 6] |= 1ULL << (i & 63);
+}
+
+// Mask of the bits [lo, hi] of a word
+static uint64_t word_mask(uint32_t lo, uint32_t hi)
+{
+    uint64_t upper = hi == 63 ? ~0ULL : (1ULL << (hi + 1)) - 1;
+    return upper & ~((1ULL << lo) - 1);
+}
+
+/*
+ * Applies op to the encodings [lo, hi]. Returns whether any (SCAN_ANY) or
+ * all (SCAN_ALL) of them are set, or how many are set (SCAN_COUNT).
+ */
+static uint64_t scan_range(bitset *set, uint64_t lo, uint64_t hi, scan_op op)
+{
+    uint64_t result = op == SCAN_ALL ? 1 : 0;
+    lo -= set->base;
+    hi -= set->base;
+
+    for (uint64_t w = lo >> 6; w <= hi >> 6; ++w) {
+        uint64_t mask = word_mask(w == lo >> 6 ? lo & 63 : 0,
+                                  w == hi >> 6 ? hi & 63 : 63);
+        uint64_t bits = set->words[w] & mask;
+        switch (op) {
+            case SCAN_ANY:
+                if (bits != 0)
+                    return 1;
+                break;
+            case SCAN_ALL:
+                if (bits != mask)
+                    return 0;
+                break;
+            case SCAN_COUNT:
+                result += __builtin_popcountll(bits);
+                break;
+            case SCAN_CLEAR:
+                set->words[w] &= ~mask;
+                break;
+        }
+    }
+    return result;
+}
+
+/*
+ * Applies op to every encoding matching value in the bits not set in
+ * free. The trailing free bits form contiguous ranges, which are scanned
+ * a word at a time, and the other free bits are enumerated.
+ */
+static uint64_t scan_pattern(bitset *set, uint32_t value, uint32_t free,
+                             scan_op op)
+{
+    uint32_t low_bits = free == 0xffffffff ? 32 : __builtin_ctz(~free);
+    uint64_t run_length = 1ULL << low_bits;
+    uint32_t outer = low_bits == 32 ? 0 : free & ~(uint32_t)(run_length - 1);
+
+    uint64_t result = op == SCAN_ALL ? 1 : 0;
+    uint32_t sub = 0;
+    do {
+        uint64_t lo = value | sub;
+        uint64_t ret = scan_range(set, lo, lo + run_length - 1, op);
+        if (op == SCAN_ANY && ret)
+            return 1;
+        if (op == SCAN_ALL && !ret)
+            return 0;
+        if (op == SCAN_COUNT)
+            result += ret;
+        // Next subset of the outer free bits
+        sub = (sub - outer) & outer;
+    } while (sub != 0);
+    return result;
+}
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    // Hits not covered by a pattern yet
+    bitset remaining;
+    // Encodings a pattern may cover: the hits and the don't-cares
+    bitset allowed;
+    // Don't treat the encodings that weren't executed as don't-cares
+    bool exact;
+} search_space;
+
+/*
+ * Checks whether a pattern can be extended to the encodings matching
+ * value in the bits not set in free, i.e. whether they are all in the
+ * range and allowed.
+ */
+static bool can_extend(search_space *space, uint32_t value, uint32_t free)
+{
+    if (value < space->start || (value | free) > space->end)
+        return false;
+    return scan_pattern(&space->allowed, value, free, SCAN_ALL);
+}
+
+/*
+ * Grows the pattern of a hit by freeing one bit at a time, from the least
+ * significant one, as long as the other half of the grown pattern can be
+ * covered. A bit that can't be freed never can after other bits were
+ * freed either (the half only gets bigger), so a single pass is enough.
+ */
+static void grow_pattern(search_space *space, uint32_t insn,
+                         uint32_t *value, uint32_t *free)
+{
+    *value = insn;
+    *free = 0;
+
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+        uint32_t flipped = *value ^ (1U << bit);
+        if (!can_extend(space, flipped, *free))
+            continue;
+        *free |= 1U << bit;
+        *value &= ~(1U << bit);
+    }
+}
+
+static bool is_hit(result_class class)
+{
+    return class != RESULT_UNVISITED && class != RESULT_SKIPPED
+           && class != RESULT_FILTERED && class != RESULT_UNEXECUTED
+           && class != RESULT_SIGILL && class < RESULT_CLASS_COUNT;
+}
+
+// Visited, but not executed, so they might as well be hits
+static bool is_dont_care(result_class class)
+{
+    return class == RESULT_SKIPPED || class == RESULT_FILTERED
+           || class == RESULT_UNEXECUTED;
+}
+
+static int read_map(search_space *space, int fd, const char *path)
+{
+    uint8_t *buf = malloc(CHUNK_SIZE);
+    if (buf == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate buffer\n");
+        return -1;
+    }
+
+    uint64_t first_byte = space->start / 2;
+    uint64_t last_byte = space->end / 2;
+    for (uint64_t chunk = first_byte; chunk <= last_byte; ) {
+        // Skip the parts of the map that were never written
+        off_t data = lseek(fd, RESULT_MAP_HEADER_SIZE + chunk, SEEK_DATA);
+        if (data == -1 && errno == ENXIO)
+            break;
+        if (data != -1 && (uint64_t)data > RESULT_MAP_HEADER_SIZE + chunk) {
+            chunk = data - RESULT_MAP_HEADER_SIZE;
+            continue;
+        }
+
+        size_t length = CHUNK_SIZE;
+        if (chunk + length > last_byte + 1)
+            length = last_byte + 1 - chunk;
+
+        if (pread(fd, buf, length, RESULT_MAP_HEADER_SIZE + chunk)
+                != (ssize_t)length) {
+            fprintf(stderr, "ERROR: Unable to read %s\n", path);
+            free(buf);
+            return -1;
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+            if (buf[i] == 0)
+                continue;
+
+            for (uint32_t half = 0; half < 2; ++half) {
+                uint32_t insn = (uint32_t)((chunk + i) * 2 + half);
+                result_class class = (buf[i] >> (half * 4)) & 0xf;
+                if (insn < space->start || insn > space->end)
+                    continue;
+
+                if (is_hit(class)) {
+                    set_bit(&space->remaining, insn);
+                    set_bit(&space->allowed, insn);
+                } else if (is_dont_care(class) && !space->exact) {
+                    set_bit(&space->allowed, insn);
+                }
+            }
+        }
+        chunk += length;
+    }
+
+    free(buf);
+    return 0;
+}
+
+/*
+ * Reads the hits from a fuzzer log: the hidden, timeout and syscall lines.
+ */
+static int read_log(search_space *space, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, fp) != -1) {
+        if (line[0] == '#')
+            continue;
+
+        char *kind;
+        unsigned long insn = strtoul(line, &kind, 16);
+        if (*kind != ',' || insn < space->start || insn > space->end)
+            continue;
+        ++kind;
+
+        if (strncmp(kind, "hidden,", 7) == 0
+                || strncmp(kind, "timeout,", 8) == 0
+                || strncmp(kind, "syscall,", 8) == 0) {
+            set_bit(&space->remaining, insn);
+            set_bit(&space->allowed, insn);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+static void print_help(char *cmd_name)
+{
+    printf("Usage: %s [option(s)] <log_or_map>...\n", cmd_name);
+    printf("\n\
+Reads the hidden instructions from fuzzer logs and/or result maps, and\n\
+prints a small set of patterns covering them, as the -s and -m options\n\
+of the fuzzer, followed by the number of hits first covered by the\n\
+pattern and its size.\n\
+\n\
+The patterns may include encodings that were visited but not executed\n\
+according to the result maps (skipped, filtered or -n), but neither\n\
+ones that raised SIGILL nor unvisited ones. Without result maps, they\n\
+only cover hits.\n\
+\n\
+Options:\n\
+    -h, --help              Print help information.\n\
+    -s, --start <insn>      Start of the range (in hex).\n\
+    -e, --end <insn>        End of the range, inclusive (in hex).\n\
+    -x, --exact             Only cover hits, even with result maps.\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    search_space space = {
+        .start = 0x00000000,
+        .end = 0xffffffff,
+    };
+
+    struct option long_options[] = {
+        {"help",    no_argument,        NULL, 'h'},
+        {"start",   required_argument,  NULL, 's'},
+        {"end",     required_argument,  NULL, 'e'},
+        {"exact",   no_argument,        NULL, 'x'},
+        {NULL,      0,                  NULL, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hs:e:x", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                space.start = strtoul(optarg, NULL, 16);
+                break;
+            case 'e':
+                space.end = strtoul(optarg, NULL, 16);
+                break;
+            case 'x':
+                space.exact = true;
+                break;
+            case 'h':
+            default:
+                print_help(argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind < 1 || space.end < space.start) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    int map_fds[argc];
+    for (int i = optind; i < argc; ++i) {
+        map_fds[i] = open(argv[i], O_RDONLY);
+        if (map_fds[i] == -1) {
+            perror(argv[i]);
+            return 1;
+        }
+        // Anything else is read as a log
+        result_map_header header;
+        if (read_result_map_header(map_fds[i], &header) != 0) {
+            close(map_fds[i]);
+            map_fds[i] = -1;
+        }
+    }
+
+    if (init_bitset(&space.remaining, space.start, space.end) == -1
+            || init_bitset(&space.allowed, space.start, space.end) == -1) {
+        fprintf(stderr, "ERROR: Unable to allocate bitsets\n");
+        return 1;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        int ret = map_fds[i] != -1 ? read_map(&space, map_fds[i], argv[i])
+                                   : read_log(&space, argv[i]);
+        if (ret == -1)
+            return 1;
+        if (map_fds[i] != -1)
+            close(map_fds[i]);
+    }
+
+    uint64_t hit_count = 0;
+    uint64_t pattern_count = 0;
+    uint64_t covered = 0;
+    bitset *remaining = &space.remaining;
+    for (uint64_t w = 0; w < remaining->word_count; ++w) {
+        // Covering a hit clears the hits of its pattern, including this one
+        while (remaining->words[w] != 0) {
+            uint32_t insn = remaining->base + w * 64
+                            + __builtin_ctzll(remaining->words[w]);
+            uint32_t value, free;
+            grow_pattern(&space, insn, &value, &free);
+
+            uint64_t new_hits = scan_pattern(remaining, value, free,
+                                             SCAN_COUNT);
+            scan_pattern(remaining, value, free, SCAN_CLEAR);
+
+            uint64_t size = 1ULL << __builtin_popcount(free);
+            printf("-s %08" PRIx32 " -m %08" PRIx32 "  # %" PRIu64 " hits, "
+                   "%" PRIu64 " encodings\n", value, free, new_hits, size);
+
+            hit_count += new_hits;
+            ++pattern_count;
+            covered += size;
+        }
+    }
+
+    fprintf(stderr, "hits: %" PRIu64 ", patterns: %" PRIu64 ", "
+                    "encodings covered: %" PRIu64 "\n",
+            hit_count, pattern_count, covered);
+    return 0;
+}
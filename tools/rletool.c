@@ -0,0 +1,369 @@
+/*
+ * Tool for working with run-length encoded result maps (as written by the
+ * fuzzer's -R option): printing, random access, merging the per-worker
+ * maps, diffing two runs and converting raw result maps (-M).
+ *
+ * None of the commands expand the maps to a full bitmap.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "resmap.h"
+#include "rlemap.h"
+
+// Bytes read at a time when converting raw result maps
+#define CONVERT_CHUNK_SIZE (1 << 22)
+
+/*
+ * Iterates over a map as a sequence of segments covering the whole
+ * instruction space, where the gaps between runs are unvisited segments.
+ */
+typedef struct {
+    rle_reader *reader;
+    rle_record pending;
+    bool has_pending;
+    uint64_t pos;
+} segment_iterator;
+
+static int next_segment(segment_iterator *it, rle_record *segment)
+{
+    if (it->pos > 0xffffffff)
+        return 0;
+
+    if (!it->has_pending) {
+        int ret = rle_next(it->reader, &it->pending);
+        if (ret == -1)
+            return -1;
+        it->has_pending = (ret == 1);
+    }
+
+    if (it->has_pending && it->pending.first == it->pos) {
+        *segment = it->pending;
+        it->has_pending = false;
+    } else {
+        segment->first = it->pos;
+        segment->last = it->has_pending ? it->pending.first - 1 : 0xffffffff;
+        segment->class = RESULT_UNVISITED;
+    }
+
+    it->pos = (uint64_t)segment->last + 1;
+    return 1;
+}
+
+static int open_reader(rle_reader *reader, const char *path)
+{
+    if (open_rle_reader(reader, path) == -1) {
+        fprintf(stderr, "ERROR: Unable to open %s: %s\n", path,
+                errno == EINVAL ? "not a valid RLE map" : strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int cmd_cat(int argc, char **argv)
+{
+    if (argc != 1)
+        return -1;
+
+    rle_reader reader;
+    if (open_reader(&reader, argv[0]) == -1)
+        return 1;
+
+    rle_record record;
+    int ret;
+    while ((ret = rle_next(&reader, &record)) == 1) {
+        printf("%08" PRIx32 "-%08" PRIx32 ",%s\n",
+               record.first, record.last, result_class_name(record.class));
+    }
+
+    close_rle_reader(&reader);
+    return ret == -1 ? 1 : 0;
+}
+
+static int cmd_lookup(int argc, char **argv)
+{
+    if (argc < 2)
+        return -1;
+
+    rle_reader reader;
+    if (open_reader(&reader, argv[0]) == -1)
+        return 1;
+
+    for (int i = 1; i < argc; ++i) {
+        uint32_t insn = strtoul(argv[i], NULL, 16);
+        printf("%08" PRIx32 ",%s\n", insn,
+               result_class_name(rle_lookup(&reader, insn)));
+    }
+
+    close_rle_reader(&reader);
+    return 0;
+}
+
+static int cmd_merge(int argc, char **argv)
+{
+    if (argc < 2)
+        return -1;
+
+    int map_count = argc - 1;
+    rle_reader *readers = calloc(map_count, sizeof(rle_reader));
+    rle_record *records = calloc(map_count, sizeof(rle_record));
+    bool *has_record = calloc(map_count, sizeof(bool));
+    if (readers == NULL || records == NULL || has_record == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < map_count; ++i) {
+        if (open_reader(&readers[i], argv[i + 1]) == -1)
+            return 1;
+        if (readers[i].isa != readers[0].isa) {
+            fprintf(stderr, "ERROR: The maps are from different ISAs\n");
+            return 1;
+        }
+        has_record[i] = (rle_next(&readers[i], &records[i]) == 1);
+    }
+
+    rle_writer writer;
+    if (open_rle_writer(&writer, argv[0], readers[0].isa) == -1) {
+        perror("Unable to open output map");
+        return 1;
+    }
+
+    while (true) {
+        int min = -1;
+        for (int i = 0; i < map_count; ++i) {
+            if (has_record[i]
+                    && (min == -1 || records[i].first < records[min].first))
+                min = i;
+        }
+        if (min == -1)
+            break;
+
+        if (rle_append_run(&writer, &records[min]) == -1) {
+            fprintf(stderr, "ERROR: %s has runs overlapping with another "
+                            "map at %08" PRIx32 "\n",
+                    argv[min + 1], records[min].first);
+            return 1;
+        }
+        has_record[min] = (rle_next(&readers[min], &records[min]) == 1);
+    }
+
+    for (int i = 0; i < map_count; ++i)
+        close_rle_reader(&readers[i]);
+
+    if (close_rle_writer(&writer) == -1) {
+        perror("Unable to write output map");
+        return 1;
+    }
+
+    free(readers);
+    free(records);
+    free(has_record);
+    return 0;
+}
+
+static int cmd_diff(int argc, char **argv)
+{
+    if (argc != 2)
+        return -1;
+
+    rle_reader reader_a, reader_b;
+    if (open_reader(&reader_a, argv[0]) == -1
+            || open_reader(&reader_b, argv[1]) == -1)
+        return 1;
+
+    if (reader_a.isa != reader_b.isa)
+        fprintf(stderr, "WARNING: The maps are from different ISAs\n");
+
+    static uint64_t pair_counts[RESULT_CLASS_COUNT + 1][RESULT_CLASS_COUNT + 1];
+    segment_iterator it_a = { .reader = &reader_a };
+    segment_iterator it_b = { .reader = &reader_b };
+    rle_record seg_a, seg_b;
+    rle_record diff = {0};
+    bool diff_active = false;
+    uint64_t diff_count = 0;
+
+    if (next_segment(&it_a, &seg_a) != 1 || next_segment(&it_b, &seg_b) != 1)
+        return 1;
+
+    uint64_t pos = 0;
+    while (pos <= 0xffffffff) {
+        uint32_t end = seg_a.last < seg_b.last ? seg_a.last : seg_b.last;
+
+        if (seg_a.class != seg_b.class) {
+            // Pack both classes into one to coalesce adjacent differences
+            uint32_t class_pair = (seg_a.class << 8) | seg_b.class;
+            if (diff_active && diff.class == class_pair
+                    && diff.last + 1 == pos) {
+                diff.last = end;
+            } else {
+                if (diff_active)
+                    printf("%08" PRIx32 "-%08" PRIx32 ",%s,%s\n",
+                           diff.first, diff.last,
+                           result_class_name(diff.class >> 8),
+                           result_class_name(diff.class & 0xff));
+                diff.first = pos;
+                diff.last = end;
+                diff.class = class_pair;
+                diff_active = true;
+            }
+
+            uint32_t a = seg_a.class < RESULT_CLASS_COUNT
+                         ? seg_a.class : RESULT_CLASS_COUNT;
+            uint32_t b = seg_b.class < RESULT_CLASS_COUNT
+                         ? seg_b.class : RESULT_CLASS_COUNT;
+            pair_counts[a][b] += (uint64_t)end - pos + 1;
+            diff_count += (uint64_t)end - pos + 1;
+        }
+
+        pos = (uint64_t)end + 1;
+        if (seg_a.last == end && next_segment(&it_a, &seg_a) == -1)
+            return 1;
+        if (seg_b.last == end && next_segment(&it_b, &seg_b) == -1)
+            return 1;
+    }
+
+    if (diff_active)
+        printf("%08" PRIx32 "-%08" PRIx32 ",%s,%s\n",
+               diff.first, diff.last,
+               result_class_name(diff.class >> 8),
+               result_class_name(diff.class & 0xff));
+
+    fprintf(stderr, "differences: %" PRIu64 "\n", diff_count);
+    for (uint32_t a = 0; a <= RESULT_CLASS_COUNT; ++a) {
+        for (uint32_t b = 0; b <= RESULT_CLASS_COUNT; ++b) {
+            if (pair_counts[a][b] != 0)
+                fprintf(stderr, "    %-10s -> %-10s %" PRIu64 "\n",
+                        result_class_name(a), result_class_name(b),
+                        pair_counts[a][b]);
+        }
+    }
+
+    close_rle_reader(&reader_a);
+    close_rle_reader(&reader_b);
+    return diff_count == 0 ? 0 : 2;
+}
+
+static int cmd_convert(int argc, char **argv)
+{
+    if (argc != 2)
+        return -1;
+
+    int fd = open(argv[0], O_RDONLY);
+    if (fd == -1) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    result_map_header header;
+    if (read_result_map_header(fd, &header) != 0) {
+        fprintf(stderr, "ERROR: %s is not a valid result map\n", argv[0]);
+        return 1;
+    }
+
+    rle_writer writer;
+    if (open_rle_writer(&writer, argv[1], header.isa) == -1) {
+        perror("Unable to open output map");
+        return 1;
+    }
+
+    uint8_t *buf = malloc(CONVERT_CHUNK_SIZE);
+    if (buf == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory\n");
+        return 1;
+    }
+
+    uint64_t chunk = 0;
+    while (chunk < RESULT_MAP_ENTRY_COUNT / 2) {
+        // Skip holes, i.e. slices that no worker has written to
+        off_t data = lseek(fd, RESULT_MAP_HEADER_SIZE + chunk, SEEK_DATA);
+        if (data == -1 && errno == ENXIO)
+            break;
+        if (data > (off_t)(RESULT_MAP_HEADER_SIZE + chunk)) {
+            chunk = data - RESULT_MAP_HEADER_SIZE;
+            continue;
+        }
+
+        size_t length = CONVERT_CHUNK_SIZE;
+        if (chunk + length > RESULT_MAP_ENTRY_COUNT / 2)
+            length = RESULT_MAP_ENTRY_COUNT / 2 - chunk;
+
+        if (pread(fd, buf, length, RESULT_MAP_HEADER_SIZE + chunk)
+                != (ssize_t)length) {
+            fprintf(stderr, "ERROR: Unable to read %s\n", argv[0]);
+            return 1;
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+            for (uint32_t half = 0; half < 2; ++half) {
+                result_class class = (buf[i] >> (half * 4)) & 0xf;
+                if (class == RESULT_UNVISITED)
+                    continue;
+                if (rle_append(&writer, (chunk + i) * 2 + half, class) == -1) {
+                    perror("Unable to write output map");
+                    return 1;
+                }
+            }
+        }
+        chunk += length;
+    }
+
+    free(buf);
+    close(fd);
+
+    if (close_rle_writer(&writer) == -1) {
+        perror("Unable to write output map");
+        return 1;
+    }
+    return 0;
+}
+
+static void print_help(char *cmd_name)
+{
+    printf("Usage: %s <command> [argument(s)]\n", cmd_name);
+    printf("\n\
+Commands:\n\
+    cat <map>                   Print all runs as <first>-<last>,<result>.\n\
+    lookup <map> <insn>...      Print the result of the given instructions\n\
+                                (in hex).\n\
+    merge <out> <map>...        Merge the (non-overlapping) per-worker maps\n\
+                                into a single map.\n\
+    diff <map_a> <map_b>        Print the encoding ranges where two maps\n\
+                                differ, as <first>-<last>,<result_a>,\n\
+                                <result_b>, followed by a summary.\n\
+    convert <result_map> <out>  Convert a raw result map (fuzzer -M option)\n\
+                                to an RLE map.\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    int ret = -1;
+    if (strcmp(argv[1], "cat") == 0)
+        ret = cmd_cat(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "lookup") == 0)
+        ret = cmd_lookup(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "merge") == 0)
+        ret = cmd_merge(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "diff") == 0)
+        ret = cmd_diff(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "convert") == 0)
+        ret = cmd_convert(argc - 2, argv + 2);
+
+    if (ret == -1) {
+        print_help(argv[0]);
+        return 1;
+    }
+    return ret;
+}